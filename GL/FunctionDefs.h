@@ -14,6 +14,15 @@ GL_BIND_BUFFER_FUNC glBindBuffer;
 typedef void (*GL_BUFFER_DATA_FUNC)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
 GL_BUFFER_DATA_FUNC glBufferData;
 
+typedef void (*GL_DELETE_BUFFERS_FUNC)(GLsizei n, const GLuint* buffers);
+GL_DELETE_BUFFERS_FUNC glDeleteBuffers;
+
+typedef void* (*GL_MAP_BUFFER_FUNC)(GLenum target, GLenum access);
+GL_MAP_BUFFER_FUNC glMapBuffer;
+
+typedef GLboolean (*GL_UNMAP_BUFFER_FUNC)(GLenum target);
+GL_UNMAP_BUFFER_FUNC glUnmapBuffer;
+
 typedef void (*GL_GEN_VERTEX_ARRAYS_FUNC)(GLsizei n, GLuint* vaos);
 GL_GEN_VERTEX_ARRAYS_FUNC glGenVertexArrays;
 
@@ -73,6 +82,9 @@ void LoadOpenGLFunctions()
   glGenBuffers = LOAD_GL_FUNC(GL_GEN_BUFFERS_FUNC, "glGenBuffers");
   glBindBuffer = LOAD_GL_FUNC(GL_BIND_BUFFER_FUNC, "glBindBuffer");
   glBufferData = LOAD_GL_FUNC(GL_BUFFER_DATA_FUNC, "glBufferData");
+  glDeleteBuffers = LOAD_GL_FUNC(GL_DELETE_BUFFERS_FUNC, "glDeleteBuffers");
+  glMapBuffer = LOAD_GL_FUNC(GL_MAP_BUFFER_FUNC, "glMapBuffer");
+  glUnmapBuffer = LOAD_GL_FUNC(GL_UNMAP_BUFFER_FUNC, "glUnmapBuffer");
 
   glGenVertexArrays = LOAD_GL_FUNC(GL_GEN_VERTEX_ARRAYS_FUNC, "glGenVertexArrays");
   glBindVertexArray = LOAD_GL_FUNC(GL_BIND_VERTEX_ARRAY_FUNC, "glBindVertexArray");
@@ -0,0 +1,68 @@
+// Counter based pseudo random number generation (Philox 4x32-10, Salmon et al. 2011).
+// Every output is a pure function of a 128 bit counter and a 64 bit key: there is no state to share, so values
+// can be generated in any order from any number of threads and are identical from one run or machine to another.
+
+struct RandomCounter
+{
+  unsigned int Words[4];
+};
+
+struct RandomKey
+{
+  unsigned int Words[2];
+};
+
+static const unsigned int PHILOX_M0 = 0xD2511F53;
+static const unsigned int PHILOX_M1 = 0xCD9E8D57;
+static const unsigned int PHILOX_W0 = 0x9E3779B9;
+static const unsigned int PHILOX_W1 = 0xBB67AE85;
+
+static RandomCounter PhiloxRound(const RandomCounter& c, const RandomKey& k)
+{
+  unsigned long long Product0 = static_cast<unsigned long long>(PHILOX_M0) * c.Words[0];
+  unsigned long long Product1 = static_cast<unsigned long long>(PHILOX_M1) * c.Words[2];
+
+  unsigned int Hi0 = static_cast<unsigned int>(Product0 >> 32), Lo0 = static_cast<unsigned int>(Product0);
+  unsigned int Hi1 = static_cast<unsigned int>(Product1 >> 32), Lo1 = static_cast<unsigned int>(Product1);
+
+  return {{ Hi1 ^ c.Words[1] ^ k.Words[0], Lo1, Hi0 ^ c.Words[3] ^ k.Words[1], Lo0 }};
+}
+
+// Returns 4 random 32 bit words for the given counter and key.
+static RandomCounter Philox4x32(RandomCounter Counter, RandomKey Key)
+{
+  for (int Round = 0; Round < 10; Round++)
+    {
+      if (Round > 0)
+	{
+	  Key.Words[0] += PHILOX_W0;
+	  Key.Words[1] += PHILOX_W1;
+	}
+      Counter = PhiloxRound(Counter, Key);
+    }
+
+  return Counter;
+}
+
+static RandomKey MakeRandomKey(unsigned long long Seed)
+{
+  return {{ static_cast<unsigned int>(Seed), static_cast<unsigned int>(Seed >> 32) }};
+}
+
+// Counter for the Nth block of random values of a given item (particle index, ...) and stream.
+static RandomCounter MakeRandomCounter(unsigned long long Item, unsigned int Stream, unsigned int Block = 0)
+{
+  return {{ static_cast<unsigned int>(Item), static_cast<unsigned int>(Item >> 32), Stream, Block }};
+}
+
+// Maps a random word to a float uniformly distributed in [0, 1).
+static float RandomUnitFloat(unsigned int Word)
+{
+  return (Word >> 8) * (1.f / 16777216.f);
+}
+
+// Maps a random word to a float uniformly distributed in (0, 1), safe to pass to log().
+static float RandomOpenUnitFloat(unsigned int Word)
+{
+  return ((Word >> 8) + 0.5f) * (1.f / 16777216.f);
+}
@@ -0,0 +1,191 @@
+// Quality governor. Included by ParticleSimulation.cpp, after the SimulationContext definition.
+//
+// The platform layer reports how long simulating and drawing took every frame. Every QUALITY_GOVERNOR_WINDOW frames, the
+// governor compares their average to Config.FrameBudget and changes at most one setting:
+// - Over budget: enable one more worker if allowed, otherwise drop a substep or double RenderStride, whichever targets
+//   the most expensive stage.
+// - Well under budget: undo the cheapest change predicted to stay within budget, restoring render detail first, then
+//   substeps, then releasing workers.
+// Every decision gets logged with the measurements that led to it.
+
+#define QUALITY_GOVERNOR_WINDOW 30
+
+// Fractions of the budget outside of which the governor reacts, and under which a predicted cost must stay.
+#define QUALITY_GOVERNOR_OVER_BUDGET 1.05
+#define QUALITY_GOVERNOR_UNDER_BUDGET 0.75
+#define QUALITY_GOVERNOR_TARGET 0.9
+
+struct QualityGovernor
+{
+  bool IsEnabled = false;
+  double FrameBudget = 0; // Seconds.
+
+  int MinSubsteps = 1;
+  int MaxSubsteps = 1;
+  int MaxRenderStride = 1;
+  int MinWorkerCount = 1;
+  int MaxWorkerCount = 1;
+
+  int WorkerCount = 1;
+  void (*SetWorkerCount)(int WorkerCount) = nullptr; // Null when workers can't be changed.
+
+  // Measurements of the current window.
+  int WindowFrameCount = 0;
+  double WindowSimulationSeconds = 0;
+  double WindowDrawSeconds = 0;
+
+  bool IsAtBounds = false; // Over budget with nothing left to lower, already logged.
+  int DecisionCount = 0;
+  FILE* Log = nullptr;
+};
+
+// Sets up the governor from the configuration's budget and bounds. WorkerCount is the size of the platform's worker pool.
+// Call before the Simulation gets initialized: the configured Substeps and RenderStride get clamped to the bounds.
+void InitializeQualityGovernor(QualityGovernor& Governor, SimulationConfig& Config, int WorkerCount, void (*SetWorkerCount)(int), FILE* Log)
+{
+  Governor.IsEnabled = Config.FrameBudget > 0;
+  Governor.FrameBudget = Config.FrameBudget / 1000.0;
+  Governor.Log = Log != nullptr ? Log : stdout;
+
+  Governor.MinSubsteps = Config.MinSubsteps;
+  Governor.MaxSubsteps = Config.MaxSubsteps > Config.MinSubsteps ? Config.MaxSubsteps : Config.MinSubsteps;
+  Governor.MaxRenderStride = Config.MaxRenderStride;
+
+  Governor.SetWorkerCount = SetWorkerCount;
+  Governor.MaxWorkerCount = Config.MaxWorkerCount > 0 && Config.MaxWorkerCount < WorkerCount ? Config.MaxWorkerCount : WorkerCount;
+  Governor.MinWorkerCount = Config.MinWorkerCount < Governor.MaxWorkerCount ? Config.MinWorkerCount : Governor.MaxWorkerCount;
+  Governor.WorkerCount = Governor.MaxWorkerCount;
+
+  if (!Governor.IsEnabled)
+    {
+      return;
+    }
+
+  if (Config.Substeps < Governor.MinSubsteps)
+    {
+      Config.Substeps = Governor.MinSubsteps;
+    }
+  if (Config.Substeps > Governor.MaxSubsteps)
+    {
+      Config.Substeps = Governor.MaxSubsteps;
+    }
+  if (Config.RenderStride > Governor.MaxRenderStride)
+    {
+      Config.RenderStride = Governor.MaxRenderStride;
+    }
+  if (SetWorkerCount != nullptr)
+    {
+      SetWorkerCount(Governor.WorkerCount);
+    }
+
+  fprintf(Governor.Log, "Governor: budget %.2fms, substeps %d [%d, %d], render stride %d [1, %d], workers %d [%d, %d].\n",
+	  Governor.FrameBudget * 1000, Config.Substeps, Governor.MinSubsteps, Governor.MaxSubsteps,
+	  Config.RenderStride, Governor.MaxRenderStride, Governor.WorkerCount, Governor.MinWorkerCount, Governor.MaxWorkerCount);
+  fflush(Governor.Log);
+}
+
+static void LogQualityDecision(QualityGovernor& Governor, const SimulationContext& Context, double SimulationSeconds, double DrawSeconds,
+			       const char* Setting, int OldValue, int NewValue, const char* Reason)
+{
+  Governor.DecisionCount++;
+  fprintf(Governor.Log, "Governor: tick %d, simulation %.2fms + draw %.2fms = %.2fms for %.2fms budget: %s %d -> %d (%s).\n",
+	  Context.TickCount, SimulationSeconds * 1000, DrawSeconds * 1000, (SimulationSeconds + DrawSeconds) * 1000,
+	  Governor.FrameBudget * 1000, Setting, OldValue, NewValue, Reason);
+  fflush(Governor.Log);
+}
+
+static void ChangeWorkerCount(QualityGovernor& Governor, int WorkerCount)
+{
+  Governor.WorkerCount = WorkerCount;
+  Governor.SetWorkerCount(WorkerCount);
+}
+
+// Records the duration of a frame's simulation and drawing, and adjusts quality settings once a window of frames is complete.
+void UpdateQualityGovernor(QualityGovernor& Governor, SimulationContext& Context, double SimulationSeconds, double DrawSeconds)
+{
+  if (!Governor.IsEnabled)
+    {
+      return;
+    }
+
+  Governor.WindowSimulationSeconds += SimulationSeconds;
+  Governor.WindowDrawSeconds += DrawSeconds;
+  Governor.WindowFrameCount++;
+  if (Governor.WindowFrameCount < QUALITY_GOVERNOR_WINDOW)
+    {
+      return;
+    }
+
+  double Simulation = Governor.WindowSimulationSeconds / Governor.WindowFrameCount;
+  double Draw = Governor.WindowDrawSeconds / Governor.WindowFrameCount;
+  double Frame = Simulation + Draw;
+  double Budget = Governor.FrameBudget;
+  Governor.WindowSimulationSeconds = 0;
+  Governor.WindowDrawSeconds = 0;
+  Governor.WindowFrameCount = 0;
+
+  bool CanChangeWorkers = Governor.SetWorkerCount != nullptr;
+
+  if (Frame > Budget * QUALITY_GOVERNOR_OVER_BUDGET)
+    {
+      int OldSubsteps = Context.SubstepCount;
+      int OldStride = Context.RenderStride;
+      bool CanLowerSubsteps = Context.SubstepCount > Governor.MinSubsteps;
+      bool CanRaiseStride = Context.RenderStride < Governor.MaxRenderStride;
+
+      // More workers come first as they cost no quality.
+      if (CanChangeWorkers && Governor.WorkerCount < Governor.MaxWorkerCount)
+	{
+	  ChangeWorkerCount(Governor, Governor.WorkerCount + 1);
+	  LogQualityDecision(Governor, Context, Simulation, Draw, "workers", Governor.WorkerCount - 1, Governor.WorkerCount, "over budget");
+	}
+      else if (CanLowerSubsteps && (Simulation > Draw || !CanRaiseStride))
+	{
+	  Context.SubstepCount--;
+	  LogQualityDecision(Governor, Context, Simulation, Draw, "substeps", OldSubsteps, Context.SubstepCount, "over budget");
+	}
+      else if (CanRaiseStride)
+	{
+	  Context.RenderStride = Context.RenderStride * 2 < Governor.MaxRenderStride ? Context.RenderStride * 2 : Governor.MaxRenderStride;
+	  LogQualityDecision(Governor, Context, Simulation, Draw, "render stride", OldStride, Context.RenderStride, "over budget");
+	}
+      else if (!Governor.IsAtBounds)
+	{
+	  Governor.DecisionCount++;
+	  fprintf(Governor.Log, "Governor: tick %d, simulation %.2fms + draw %.2fms = %.2fms for %.2fms budget: every setting at its bound.\n",
+		  Context.TickCount, Simulation * 1000, Draw * 1000, Frame * 1000, Budget * 1000);
+	  fflush(Governor.Log);
+	  Governor.IsAtBounds = true;
+	}
+
+      return;
+    }
+
+  Governor.IsAtBounds = false;
+
+  if (Frame < Budget * QUALITY_GOVERNOR_UNDER_BUDGET)
+    {
+      // Predicted costs assume drawing scales with drawn Particles, simulation with substeps and workers.
+      double Target = Budget * QUALITY_GOVERNOR_TARGET;
+      int OldSubsteps = Context.SubstepCount;
+      int OldStride = Context.RenderStride;
+
+      if (Context.RenderStride > 1 && Simulation + Draw * 2 < Target)
+	{
+	  Context.RenderStride /= 2;
+	  LogQualityDecision(Governor, Context, Simulation, Draw, "render stride", OldStride, Context.RenderStride, "under budget");
+	}
+      else if (Context.SubstepCount < Governor.MaxSubsteps && Simulation * (Context.SubstepCount + 1) / Context.SubstepCount + Draw < Target)
+	{
+	  Context.SubstepCount++;
+	  LogQualityDecision(Governor, Context, Simulation, Draw, "substeps", OldSubsteps, Context.SubstepCount, "under budget");
+	}
+      else if (CanChangeWorkers && Governor.WorkerCount > Governor.MinWorkerCount
+	       && Context.SubstepCount == Governor.MaxSubsteps && Context.RenderStride == 1
+	       && Simulation * Governor.WorkerCount / (Governor.WorkerCount - 1) + Draw < Target)
+	{
+	  ChangeWorkerCount(Governor, Governor.WorkerCount - 1);
+	  LogQualityDecision(Governor, Context, Simulation, Draw, "workers", Governor.WorkerCount + 1, Governor.WorkerCount, "under budget");
+	}
+    }
+}
@@ -0,0 +1,255 @@
+// Spatial reordering of Particles in memory. Included by ParticleSimulation.cpp, after the SimulationContext definition.
+//
+// Particles get sorted along a 3D Morton (Z-order) curve over their bounding box, so that Particles close in space end
+// up close in memory. The sort is a parallel least significant digit radix sort on 30 bit keys: each pass builds one
+// digit histogram per chunk of Particles, turns them into scatter offsets, then scatters every chunk independently.
+// Particle IDs don't change: Context.ParticleIndexByID keeps track of where each ID currently lives.
+
+#define REORDER_CHUNK_SIZE 65536
+#define REORDER_RADIX_BITS 8
+#define REORDER_RADIX_SIZE (1 << REORDER_RADIX_BITS)
+#define MORTON_BITS_PER_AXIS 10
+
+// Inactive Particles get the highest key and end up last.
+#define MORTON_INACTIVE_KEY 0xFFFFFFFF
+
+// Spreads the 10 lowest bits of Value so that two zero bits separate each of them.
+static unsigned int SpreadMortonBits(unsigned int Value)
+{
+  Value &= 0x3FF;
+  Value = (Value | (Value << 16)) & 0x030000FF;
+  Value = (Value | (Value << 8)) & 0x0300F00F;
+  Value = (Value | (Value << 4)) & 0x030C30C3;
+  Value = (Value | (Value << 2)) & 0x09249249;
+  return Value;
+}
+
+struct ReorderJobData
+{
+  SimulationContext* Context;
+  int ChunkCount;
+
+  // Bounds pass
+  WorldVector* ChunkMin;
+  WorldVector* ChunkMax;
+  WorldVector BoundsMin;
+  WorldVector QuantizationScale;
+
+  // Sort passes
+  unsigned int* Keys;
+  int* Indices;
+  unsigned int* SortedKeys;
+  int* SortedIndices;
+  int* ChunkDigitOffsets; // ChunkCount * REORDER_RADIX_SIZE. Digit counts, then scatter offsets.
+  int Shift;
+};
+
+static void GetReorderChunkRange(const ReorderJobData& Data, int ChunkIndex, int& FirstParticle, int& LastParticle)
+{
+  FirstParticle = ChunkIndex * REORDER_CHUNK_SIZE;
+  LastParticle = FirstParticle + REORDER_CHUNK_SIZE;
+  if (LastParticle > Data.Context->ParticleCount)
+    {
+      LastParticle = Data.Context->ParticleCount;
+    }
+}
+
+void ComputeReorderChunkBounds(void* JobData, int ChunkIndex)
+{
+  ReorderJobData& Data = *static_cast<ReorderJobData*>(JobData);
+  int FirstParticle, LastParticle;
+  GetReorderChunkRange(Data, ChunkIndex, FirstParticle, LastParticle);
+
+  WorldVector Min = {INFINITY, INFINITY, INFINITY, 1};
+  WorldVector Max = {-INFINITY, -INFINITY, -INFINITY, 1};
+  for (int ParticleIndex = FirstParticle; ParticleIndex < LastParticle; ParticleIndex++)
+    {
+      const Particle& Part = Data.Context->Particles[ParticleIndex];
+      if (!Part.IsActive)
+	{
+	  continue;
+	}
+
+      Min = {fminf(Min.x, Part.WorldPosition.x), fminf(Min.y, Part.WorldPosition.y), fminf(Min.z, Part.WorldPosition.z), 1};
+      Max = {fmaxf(Max.x, Part.WorldPosition.x), fmaxf(Max.y, Part.WorldPosition.y), fmaxf(Max.z, Part.WorldPosition.z), 1};
+    }
+
+  Data.ChunkMin[ChunkIndex] = Min;
+  Data.ChunkMax[ChunkIndex] = Max;
+}
+
+void ComputeReorderChunkKeys(void* JobData, int ChunkIndex)
+{
+  ReorderJobData& Data = *static_cast<ReorderJobData*>(JobData);
+  int FirstParticle, LastParticle;
+  GetReorderChunkRange(Data, ChunkIndex, FirstParticle, LastParticle);
+
+  const float MaxCell = static_cast<float>((1 << MORTON_BITS_PER_AXIS) - 1);
+  for (int ParticleIndex = FirstParticle; ParticleIndex < LastParticle; ParticleIndex++)
+    {
+      const Particle& Part = Data.Context->Particles[ParticleIndex];
+      Data.Indices[ParticleIndex] = ParticleIndex;
+
+      if (!Part.IsActive)
+	{
+	  Data.Keys[ParticleIndex] = MORTON_INACTIVE_KEY;
+	  continue;
+	}
+
+      float CellX = fminf((Part.WorldPosition.x - Data.BoundsMin.x) * Data.QuantizationScale.x, MaxCell);
+      float CellY = fminf((Part.WorldPosition.y - Data.BoundsMin.y) * Data.QuantizationScale.y, MaxCell);
+      float CellZ = fminf((Part.WorldPosition.z - Data.BoundsMin.z) * Data.QuantizationScale.z, MaxCell);
+
+      Data.Keys[ParticleIndex] = (SpreadMortonBits(static_cast<unsigned int>(CellX)) << 2)
+	| (SpreadMortonBits(static_cast<unsigned int>(CellY)) << 1)
+	| SpreadMortonBits(static_cast<unsigned int>(CellZ));
+    }
+}
+
+void CountReorderChunkDigits(void* JobData, int ChunkIndex)
+{
+  ReorderJobData& Data = *static_cast<ReorderJobData*>(JobData);
+  int FirstParticle, LastParticle;
+  GetReorderChunkRange(Data, ChunkIndex, FirstParticle, LastParticle);
+
+  int* Counts = Data.ChunkDigitOffsets + ChunkIndex * REORDER_RADIX_SIZE;
+  memset(Counts, 0, REORDER_RADIX_SIZE * sizeof(int));
+
+  for (int KeyIndex = FirstParticle; KeyIndex < LastParticle; KeyIndex++)
+    {
+      Counts[(Data.Keys[KeyIndex] >> Data.Shift) & (REORDER_RADIX_SIZE - 1)]++;
+    }
+}
+
+void ScatterReorderChunk(void* JobData, int ChunkIndex)
+{
+  ReorderJobData& Data = *static_cast<ReorderJobData*>(JobData);
+  int FirstParticle, LastParticle;
+  GetReorderChunkRange(Data, ChunkIndex, FirstParticle, LastParticle);
+
+  int* Offsets = Data.ChunkDigitOffsets + ChunkIndex * REORDER_RADIX_SIZE;
+  for (int KeyIndex = FirstParticle; KeyIndex < LastParticle; KeyIndex++)
+    {
+      unsigned int Key = Data.Keys[KeyIndex];
+      int Destination = Offsets[(Key >> Data.Shift) & (REORDER_RADIX_SIZE - 1)]++;
+      Data.SortedKeys[Destination] = Key;
+      Data.SortedIndices[Destination] = Data.Indices[KeyIndex];
+    }
+}
+
+void GatherReorderedChunk(void* JobData, int ChunkIndex)
+{
+  ReorderJobData& Data = *static_cast<ReorderJobData*>(JobData);
+  int FirstParticle, LastParticle;
+  GetReorderChunkRange(Data, ChunkIndex, FirstParticle, LastParticle);
+
+  SimulationContext& Context = *Data.Context;
+  for (int ParticleIndex = FirstParticle; ParticleIndex < LastParticle; ParticleIndex++)
+    {
+      Context.ReorderedParticles[ParticleIndex] = Context.Particles[Data.Indices[ParticleIndex]];
+      Context.ParticleIndexByID[Context.ReorderedParticles[ParticleIndex].ID] = ParticleIndex;
+    }
+}
+
+// Sorts all Particles by Morton key of their position and updates Context.ParticleIndexByID.
+// Must only be called between ticks: any data indexed by Particle index gets invalidated.
+void ReorderParticles(SimulationContext& Context)
+{
+  if (Context.ParticleCount <= 1)
+    {
+      return;
+    }
+
+  double StartTime = Context.GetWallClockSeconds != nullptr ? Context.GetWallClockSeconds() : 0;
+
+  if (Context.ReorderedParticles == nullptr)
+    {
+      Context.ReorderedParticles = static_cast<Particle*>(malloc(Context.ParticleCount * sizeof(Particle)));
+      Context.ReorderKeys = static_cast<unsigned int*>(malloc(2 * Context.ParticleCount * sizeof(unsigned int)));
+      Context.ReorderIndices = static_cast<int*>(malloc(2 * Context.ParticleCount * sizeof(int)));
+    }
+
+  ReorderJobData Data;
+  Data.Context = &Context;
+  Data.ChunkCount = (Context.ParticleCount + REORDER_CHUNK_SIZE - 1) / REORDER_CHUNK_SIZE;
+  Data.ChunkMin = static_cast<WorldVector*>(malloc(Data.ChunkCount * sizeof(WorldVector)));
+  Data.ChunkMax = static_cast<WorldVector*>(malloc(Data.ChunkCount * sizeof(WorldVector)));
+  Data.ChunkDigitOffsets = static_cast<int*>(malloc(Data.ChunkCount * REORDER_RADIX_SIZE * sizeof(int)));
+  Data.Keys = Context.ReorderKeys;
+  Data.SortedKeys = Context.ReorderKeys + Context.ParticleCount;
+  Data.Indices = Context.ReorderIndices;
+  Data.SortedIndices = Context.ReorderIndices + Context.ParticleCount;
+
+  // Bounding box of active Particles, quantized over 2^10 cells per axis.
+  Context.RunJobs(ComputeReorderChunkBounds, &Data, Data.ChunkCount);
+
+  WorldVector Min = Data.ChunkMin[0];
+  WorldVector Max = Data.ChunkMax[0];
+  for (int ChunkIndex = 1; ChunkIndex < Data.ChunkCount; ChunkIndex++)
+    {
+      Min = {fminf(Min.x, Data.ChunkMin[ChunkIndex].x), fminf(Min.y, Data.ChunkMin[ChunkIndex].y), fminf(Min.z, Data.ChunkMin[ChunkIndex].z), 1};
+      Max = {fmaxf(Max.x, Data.ChunkMax[ChunkIndex].x), fmaxf(Max.y, Data.ChunkMax[ChunkIndex].y), fmaxf(Max.z, Data.ChunkMax[ChunkIndex].z), 1};
+    }
+
+  // A single cube keeps cells cubic, so the curve follows actual distances.
+  float Extent = fmaxf(fmaxf(Max.x - Min.x, Max.y - Min.y), Max.z - Min.z);
+  float Scale = Extent > 0 ? (1 << MORTON_BITS_PER_AXIS) / Extent : 0;
+  Data.BoundsMin = Min;
+  Data.QuantizationScale = {Scale, Scale, Scale, 1};
+
+  Context.RunJobs(ComputeReorderChunkKeys, &Data, Data.ChunkCount);
+
+  // 30 bit keys (32 with the inactive key): 4 passes of 8 bits. Passes where all keys share the same digit get skipped.
+  for (Data.Shift = 0; Data.Shift < 32; Data.Shift += REORDER_RADIX_BITS)
+    {
+      Context.RunJobs(CountReorderChunkDigits, &Data, Data.ChunkCount);
+
+      // Scatter offsets: all smaller digits of all chunks, then the same digit of previous chunks.
+      int Offset = 0;
+      bool IsSingleDigit = false;
+      for (int Digit = 0; Digit < REORDER_RADIX_SIZE; Digit++)
+	{
+	  int DigitStart = Offset;
+	  for (int ChunkIndex = 0; ChunkIndex < Data.ChunkCount; ChunkIndex++)
+	    {
+	      int& ChunkDigit = Data.ChunkDigitOffsets[ChunkIndex * REORDER_RADIX_SIZE + Digit];
+	      int Count = ChunkDigit;
+	      ChunkDigit = Offset;
+	      Offset += Count;
+	    }
+	  IsSingleDigit |= Offset - DigitStart == Context.ParticleCount;
+	}
+
+      if (IsSingleDigit)
+	{
+	  continue;
+	}
+
+      Context.RunJobs(ScatterReorderChunk, &Data, Data.ChunkCount);
+
+      unsigned int* SwappedKeys = Data.Keys;
+      Data.Keys = Data.SortedKeys;
+      Data.SortedKeys = SwappedKeys;
+
+      int* SwappedIndices = Data.Indices;
+      Data.Indices = Data.SortedIndices;
+      Data.SortedIndices = SwappedIndices;
+    }
+
+  Context.RunJobs(GatherReorderedChunk, &Data, Data.ChunkCount);
+
+  Particle* SwappedParticles = Context.Particles;
+  Context.Particles = Context.ReorderedParticles;
+  Context.ReorderedParticles = SwappedParticles;
+
+  free(Data.ChunkMin);
+  free(Data.ChunkMax);
+  free(Data.ChunkDigitOffsets);
+
+  Context.ReorderCount++;
+  if (Context.GetWallClockSeconds != nullptr)
+    {
+      Context.LastReorderSeconds = Context.GetWallClockSeconds() - StartTime;
+      Context.ReorderSecondsTotal += Context.LastReorderSeconds;
+    }
+}
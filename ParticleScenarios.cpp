@@ -0,0 +1,261 @@
+// Initial conditions generators. Included by ParticleSimulation.cpp, after the Particle and SimulationContext definitions.
+//
+// Every Particle is generated from its own index through the counter based generator of Math/Random.h, keyed by the
+// configuration's Seed. Particles can therefore be generated in parallel, in any order, and the result is bit-identical
+// from one run to the next whatever the number of threads.
+
+// Matches the factor applied to squared distances in ProcessParticlePhysics (Force = m1 * m2 / (1000 * d^2)).
+#define SIMULATION_GRAVITATIONAL_CONSTANT 0.001f
+
+// Distance under which ProcessParticlePhysics ignores a pair (1000 * d^2 <= 1).
+#define SIMULATION_FORCE_CUTOFF_DISTANCE 0.0316227766f
+
+#define SCENARIO_GENERATION_CHUNK_SIZE 16384
+
+#define SCENARIO_PI 3.14159265358979f
+
+// Random streams, so that different properties of a same Particle never share random words.
+enum ScenarioRandomStream : unsigned int
+  {
+    POSITION_STREAM,
+    VELOCITY_STREAM,
+    VELOCITY_REJECTION_STREAM
+  };
+
+static WorldVector RandomUnitDirection(float u0, float u1)
+{
+  float CosTheta = 2.f * u0 - 1.f;
+  float SinTheta = sqrtf(1.f - CosTheta * CosTheta);
+  float Phi = 2.f * SCENARIO_PI * u1;
+
+  return {SinTheta * cosf(Phi), SinTheta * sinf(Phi), CosTheta, 1};
+}
+
+// Standard normal value from two uniform values (Box-Muller).
+static float RandomGaussian(float OpenUniform0, float Uniform1)
+{
+  return sqrtf(-2.f * logf(OpenUniform0)) * cosf(2.f * SCENARIO_PI * Uniform1);
+}
+
+Particle GenerateDefaultParticle(const SimulationConfig& Config, RandomKey Key, int ParticleIndex)
+{
+  if (ParticleIndex == 0)
+    {
+      Particle Central = CreateParticle({1, 0, 1}, 0.05f, {0, 0, 0, 1});
+      Central.Mass = Config.CentralMass;
+      return Central;
+    }
+
+  RandomCounter Random = Philox4x32(MakeRandomCounter(ParticleIndex, POSITION_STREAM), Key);
+
+  Particle Part = CreateParticle({1, 0, 0}, Config.ParticleRadius,
+				 {0, RandomUnitFloat(Random.Words[0]) - 0.5f, RandomUnitFloat(Random.Words[1]) - 0.5f, 1});
+  Part.Velocity = {0, RandomUnitFloat(Random.Words[2]) - 0.5f, RandomUnitFloat(Random.Words[3]) - 0.5f, 0};
+  if (Config.Tracers)
+    {
+      Part.IsTracer = true;
+      Part.Mass = 0;
+    }
+
+  return Part;
+}
+
+// Plummer sphere sampled following Aarseth, Henon & Wielen (1974), truncated at about 12 scale radii.
+Particle GeneratePlummerParticle(const SimulationConfig& Config, RandomKey Key, int ParticleIndex, WorldVector Center, float TotalMass, int ParticleCount)
+{
+  float ScaleRadius = Config.ScaleRadius;
+
+  RandomCounter PositionRandom = Philox4x32(MakeRandomCounter(ParticleIndex, POSITION_STREAM), Key);
+  float MassFraction = RandomOpenUnitFloat(PositionRandom.Words[0]) * 0.99f;
+  float Radius = ScaleRadius / sqrtf(powf(MassFraction, -2.f / 3.f) - 1.f);
+  WorldVector Position = Center + RandomUnitDirection(RandomUnitFloat(PositionRandom.Words[1]), RandomUnitFloat(PositionRandom.Words[2])) * Radius;
+
+  // Speed as a fraction of escape speed, drawn by rejection from g(q) = q^2 (1 - q^2)^3.5.
+  float SpeedFraction = 0.5f;
+  for (unsigned int Attempt = 0; Attempt < 64; Attempt++)
+    {
+      RandomCounter Rejection = Philox4x32(MakeRandomCounter(ParticleIndex, VELOCITY_REJECTION_STREAM, Attempt), Key);
+      float q = RandomUnitFloat(Rejection.Words[0]);
+      float y = RandomUnitFloat(Rejection.Words[1]) * 0.1f;
+      if (y < q * q * powf(1.f - q * q, 3.5f))
+	{
+	  SpeedFraction = q;
+	  break;
+	}
+    }
+
+  float EscapeSpeed = sqrtf(2.f * SIMULATION_GRAVITATIONAL_CONSTANT * TotalMass) * powf(Radius * Radius + ScaleRadius * ScaleRadius, -0.25f);
+
+  RandomCounter VelocityRandom = Philox4x32(MakeRandomCounter(ParticleIndex, VELOCITY_STREAM), Key);
+
+  Particle Part = CreateParticle({1.f, 0.9f, 0.6f}, Config.ParticleRadius, Position);
+  Part.Velocity = RandomUnitDirection(RandomUnitFloat(VelocityRandom.Words[0]), RandomUnitFloat(VelocityRandom.Words[1])) * (SpeedFraction * EscapeSpeed);
+  Part.Mass = TotalMass / ParticleCount;
+
+  return Part;
+}
+
+// Rotating exponential disk lying in the Y/Z plane (facing the default camera) around a central body.
+// LocalIndex 0 is the central body. Inclination rotates the whole disk around the Y axis.
+Particle GenerateDiskParticle(const SimulationConfig& Config, RandomKey Key, int ParticleIndex, int LocalIndex, int LocalCount,
+			      WorldVector Center, WorldVector CenterVelocity, float Inclination, ColorRGB InnerColor, ColorRGB OuterColor)
+{
+  Particle Part;
+
+  if (LocalIndex == 0)
+    {
+      Part = CreateParticle({1, 0, 1}, 0.05f, Center);
+      Part.Mass = Config.CentralMass;
+      Part.Velocity = CenterVelocity;
+      return Part;
+    }
+
+  float ScaleLength = Config.ScaleRadius;
+
+  RandomCounter PositionRandom = Philox4x32(MakeRandomCounter(ParticleIndex, POSITION_STREAM), Key);
+  RandomCounter VelocityRandom = Philox4x32(MakeRandomCounter(ParticleIndex, VELOCITY_STREAM), Key);
+  RandomCounter DispersionRandom = Philox4x32(MakeRandomCounter(ParticleIndex, VELOCITY_STREAM, 1), Key);
+
+  // Surface density proportional to exp(-R / ScaleLength): radius follows a Gamma(2) distribution.
+  float Radius = -ScaleLength * logf(RandomOpenUnitFloat(PositionRandom.Words[0]) * RandomOpenUnitFloat(PositionRandom.Words[1]));
+
+  // Within the force cutoff the central body doesn't attract, and circular speed grows without bound as Radius shrinks.
+  // Twice the cutoff keeps thickness and dispersion from moving orbits into it.
+  if (Radius < 2.f * SIMULATION_FORCE_CUTOFF_DISTANCE)
+    {
+      Radius = 2.f * SIMULATION_FORCE_CUTOFF_DISTANCE;
+    }
+  float Angle = 2.f * SCENARIO_PI * RandomUnitFloat(PositionRandom.Words[2]);
+  float Height = Config.DiskThickness * RandomGaussian(RandomOpenUnitFloat(PositionRandom.Words[3]), RandomUnitFloat(VelocityRandom.Words[0]));
+
+  // Circular speed from central mass and disk mass enclosed within Radius (spherical approximation).
+  // Tracer disks have no mass of their own.
+  float DiskMass = Config.Tracers ? 0.f : Config.TotalMass;
+  float ScaledRadius = Radius / ScaleLength;
+  float EnclosedMass = Config.CentralMass + DiskMass * (1.f - (1.f + ScaledRadius) * expf(-ScaledRadius));
+  float CircularSpeed = sqrtf(SIMULATION_GRAVITATIONAL_CONSTANT * EnclosedMass / Radius);
+
+  // Small random dispersion around circular motion.
+  float Dispersion = 0.05f * CircularSpeed;
+  float RadialSpeed = Dispersion * RandomGaussian(RandomOpenUnitFloat(VelocityRandom.Words[1]), RandomUnitFloat(VelocityRandom.Words[2]));
+  float TangentialSpeed = CircularSpeed + Dispersion * RandomGaussian(RandomOpenUnitFloat(DispersionRandom.Words[0]), RandomUnitFloat(DispersionRandom.Words[1]));
+
+  float CosAngle = cosf(Angle), SinAngle = sinf(Angle);
+  WorldVector LocalPosition = {Height, Radius * CosAngle, Radius * SinAngle, 1};
+  WorldVector LocalVelocity = {0,
+			       RadialSpeed * CosAngle - TangentialSpeed * SinAngle,
+			       RadialSpeed * SinAngle + TangentialSpeed * CosAngle, 0};
+
+  float CosTilt = cosf(Inclination), SinTilt = sinf(Inclination);
+  WorldVector Position = {LocalPosition.x * CosTilt - LocalPosition.z * SinTilt, LocalPosition.y, LocalPosition.x * SinTilt + LocalPosition.z * CosTilt, 1};
+  WorldVector Velocity = {LocalVelocity.x * CosTilt - LocalVelocity.z * SinTilt, LocalVelocity.y, LocalVelocity.x * SinTilt + LocalVelocity.z * CosTilt, 0};
+
+  float ColorBlend = ScaledRadius / 4.f < 1.f ? ScaledRadius / 4.f : 1.f;
+  ColorRGB Color = {InnerColor.r + (OuterColor.r - InnerColor.r) * ColorBlend,
+		    InnerColor.g + (OuterColor.g - InnerColor.g) * ColorBlend,
+		    InnerColor.b + (OuterColor.b - InnerColor.b) * ColorBlend};
+
+  Part = CreateParticle(Color, Config.ParticleRadius, Center + Position);
+  Part.Velocity = CenterVelocity + Velocity;
+  Part.Mass = DiskMass / (LocalCount - 1);
+  Part.IsTracer = Config.Tracers;
+
+  return Part;
+}
+
+Particle GenerateUniformCubeParticle(const SimulationConfig& Config, RandomKey Key, int ParticleIndex)
+{
+  RandomCounter Random = Philox4x32(MakeRandomCounter(ParticleIndex, POSITION_STREAM), Key);
+  float HalfSize = Config.ScaleRadius;
+
+  WorldVector Position = {(RandomUnitFloat(Random.Words[0]) * 2.f - 1.f) * HalfSize,
+			  (RandomUnitFloat(Random.Words[1]) * 2.f - 1.f) * HalfSize,
+			  (RandomUnitFloat(Random.Words[2]) * 2.f - 1.f) * HalfSize, 1};
+
+  Particle Part = CreateParticle({0.8f, 0.9f, 1.f}, Config.ParticleRadius, Position);
+  Part.Mass = Config.TotalMass / Config.ParticleCount;
+
+  return Part;
+}
+
+Particle GenerateScenarioParticle(const SimulationConfig& Config, RandomKey Key, int ParticleIndex)
+{
+  switch(Config.Scenario)
+    {
+    case(ScenarioType::PLUMMER):
+      return GeneratePlummerParticle(Config, Key, ParticleIndex, {0, 0, 0, 1}, Config.TotalMass, Config.ParticleCount);
+
+    case(ScenarioType::DISK):
+      return GenerateDiskParticle(Config, Key, ParticleIndex, ParticleIndex, Config.ParticleCount,
+				  {0, 0, 0, 1}, {0, 0, 0, 0}, 0.f, {1.f, 0.9f, 0.5f}, {0.4f, 0.6f, 1.f});
+
+    case(ScenarioType::COLLIDING_GALAXIES):
+      {
+	// First half of the Particles belongs to the first galaxy, the rest to the second one.
+	// Galaxies approach each other along Y with an impact parameter of one scale length along Z.
+	int FirstGalaxyCount = Config.ParticleCount / 2;
+	bool IsFirstGalaxy = ParticleIndex < FirstGalaxyCount;
+
+	float Side = IsFirstGalaxy ? -1.f : 1.f;
+	WorldVector Center = {0, Side * Config.GalaxySeparation * 0.5f, Side * Config.ScaleRadius * 0.5f, 1};
+	WorldVector CenterVelocity = {0, -Side * Config.GalaxyApproachSpeed * 0.5f, 0, 0};
+
+	SimulationConfig GalaxyConfig = Config;
+	GalaxyConfig.TotalMass = Config.TotalMass * 0.5f;
+
+	if (IsFirstGalaxy)
+	  {
+	    return GenerateDiskParticle(GalaxyConfig, Key, ParticleIndex, ParticleIndex, FirstGalaxyCount,
+					Center, CenterVelocity, 0.f, {1.f, 0.8f, 0.4f}, {1.f, 0.3f, 0.1f});
+	  }
+
+	return GenerateDiskParticle(GalaxyConfig, Key, ParticleIndex, ParticleIndex - FirstGalaxyCount, Config.ParticleCount - FirstGalaxyCount,
+				    Center, CenterVelocity, Config.GalaxyInclination, {0.6f, 0.9f, 1.f}, {0.2f, 0.4f, 1.f});
+      }
+
+    case(ScenarioType::UNIFORM_CUBE):
+      return GenerateUniformCubeParticle(Config, Key, ParticleIndex);
+
+    default:
+      return GenerateDefaultParticle(Config, Key, ParticleIndex);
+    }
+}
+
+struct ScenarioGenerationJobData
+{
+  const SimulationConfig* Config;
+  RandomKey Key;
+  Particle* Particles;
+  int ParticleCount;
+};
+
+void GenerateScenarioChunk(void* JobData, int JobIndex)
+{
+  ScenarioGenerationJobData& Data = *static_cast<ScenarioGenerationJobData*>(JobData);
+
+  int FirstParticle = JobIndex * SCENARIO_GENERATION_CHUNK_SIZE;
+  int LastParticle = FirstParticle + SCENARIO_GENERATION_CHUNK_SIZE;
+  if (LastParticle > Data.ParticleCount)
+    {
+      LastParticle = Data.ParticleCount;
+    }
+
+  for (int ParticleIndex = FirstParticle; ParticleIndex < LastParticle; ParticleIndex++)
+    {
+      Data.Particles[ParticleIndex] = GenerateScenarioParticle(*Data.Config, Data.Key, ParticleIndex);
+      Data.Particles[ParticleIndex].ID = ParticleIndex;
+    }
+}
+
+// Fills all of the Context's Particles following its configured scenario.
+void GenerateScenario(SimulationContext& Context)
+{
+  ScenarioGenerationJobData Data;
+  Data.Config = &Context.Config;
+  Data.Key = MakeRandomKey(Context.Config.Seed);
+  Data.Particles = Context.Particles;
+  Data.ParticleCount = Context.ParticleCount;
+
+  int ChunkCount = (Context.ParticleCount + SCENARIO_GENERATION_CHUNK_SIZE - 1) / SCENARIO_GENERATION_CHUNK_SIZE;
+  Context.RunJobs(GenerateScenarioChunk, &Data, ChunkCount);
+}
@@ -1,6 +1,10 @@
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "Math/WorldMath.h"
+#include "Math/Random.h"
 
 struct ColorRGB
 {
@@ -8,6 +12,7 @@ struct ColorRGB
 };
 
 
+// Default Particle count, when not specified by the Simulation's configuration.
 #define SIMULATION_PARTICLE_COUNT 512
 
 struct Particle
@@ -18,6 +23,8 @@ struct Particle
   float Radius = 1.f;
   float Mass = 1;
   bool IsActive = false;
+  bool IsTracer = false; // Tracers feel the gravity of other Particles but don't attract anything themselves.
+  int ID = 0; // Index the Particle was created at. Stays the same when Particles get reordered in memory.
 };
 
 enum class SimulationInputKey : int
@@ -43,17 +50,285 @@ enum class SimulationInputState
     RELEASED
   };
 
+enum class ScenarioType
+  {
+    DEFAULT,            // One massive body surrounded by light particles in the Y/Z plane.
+    PLUMMER,            // Plummer sphere in equilibrium.
+    DISK,               // Rotating exponential disk around a central mass.
+    COLLIDING_GALAXIES, // Two disks on a collision course.
+    UNIFORM_CUBE,       // Cold uniform cube.
+    
+    SCENARIO_TYPE_COUNT
+  };
+
+static const char* ScenarioTypeNames[] = { "Default", "Plummer", "Disk", "CollidingGalaxies", "UniformCube" };
+
+// Configuration of a Simulation run. Two Simulations sharing the same configuration produce the same initial conditions.
+struct SimulationConfig
+{
+  ScenarioType Scenario = ScenarioType::DEFAULT;
+  unsigned long long Seed = 1;
+  int ParticleCount = SIMULATION_PARTICLE_COUNT;
+
+  float CentralMass = 500;     // Mass of central bodies (Default, Disk, CollidingGalaxies).
+  float TotalMass = 500;       // Mass shared by all other particles (Plummer, Disk, CollidingGalaxies, UniformCube).
+  float ScaleRadius = 0.25f;   // Plummer radius, disk scale length or cube half size.
+  float DiskThickness = 0.01f; // Standard deviation of disk particles' height.
+  float ParticleRadius = 0.01f;
+
+  // CollidingGalaxies
+  float GalaxySeparation = 1.2f;
+  float GalaxyApproachSpeed = 0.2f;
+  float GalaxyInclination = 0.6f; // Tilt of the second galaxy, in radians.
+
+  // Makes light Particles orbiting central bodies massless tracers (Default, Disk, CollidingGalaxies), so that physics
+  // cost grows with TracerCount * SourceCount instead of ParticleCount^2.
+  bool Tracers = false;
+
+  // Accumulates forces in fixed point, so that trajectories don't depend on summation order: Particles' memory order
+  // (ReorderInterval), worker count or vectorization. Per pair terms themselves must be computed the same way, i.e.
+  // binaries built without -ffast-math and with -ffp-contract=off when comparing runs across machines.
+  // Forces then cost about 20% more with every Particle a source and 40% more with few sources and many tracers, mostly
+  // converting each term to an integer (measured with Unix_ForceBenchmark.cpp).
+  bool ReproducibleForces = false;
+
+  // Ticks between two sorts of Particles along a Morton curve, keeping spatial neighbours close in memory. 0 disables sorting.
+  int ReorderInterval = 0;
+
+  // Physics ticks run per frame, each advancing the Simulation by a fraction of the frame's time.
+  int Substeps = 1;
+  // Only one Particle in RenderStride gets drawn. Sources are always drawn when there are tracers.
+  int RenderStride = 1;
+
+  // Quality governor (ParticleQualityGovernor.cpp): target duration of simulation and drawing per frame, in milliseconds.
+  // 0 disables the governor. Substeps, RenderStride and worker count then get adjusted within the following bounds.
+  float FrameBudget = 0;
+  int MinSubsteps = 1;
+  int MaxSubsteps = 8;
+  int MaxRenderStride = 16;
+  int MinWorkerCount = 1;
+  int MaxWorkerCount = 0; // 0 uses every worker of the platform's pool.
+};
+
+// Applies a single "Key Value" configuration entry. Returns false if the key is unknown or the value invalid.
+bool SetSimulationConfigValue(SimulationConfig& Config, const char* Key, const char* Value)
+{
+  if (strcmp(Key, "Scenario") == 0)
+    {
+      for (int TypeIndex = 0; TypeIndex < static_cast<int>(ScenarioType::SCENARIO_TYPE_COUNT); TypeIndex++)
+	{
+	  if (strcmp(Value, ScenarioTypeNames[TypeIndex]) == 0)
+	    {
+	      Config.Scenario = static_cast<ScenarioType>(TypeIndex);
+	      return true;
+	    }
+	}
+      return false;
+    }
+
+  if (strcmp(Key, "Seed") == 0)
+    {
+      Config.Seed = strtoull(Value, nullptr, 0);
+      return true;
+    }
+
+  if (strcmp(Key, "Tracers") == 0)
+    {
+      Config.Tracers = atoi(Value) != 0;
+      return true;
+    }
+
+  if (strcmp(Key, "ReproducibleForces") == 0)
+    {
+      Config.ReproducibleForces = atoi(Value) != 0;
+      return true;
+    }
+
+  struct
+  {
+    const char* Key;
+    int* Value;
+    int MinValue;
+  } IntEntries[] =
+      {
+	{ "ParticleCount", &Config.ParticleCount, 1 },
+	{ "ReorderInterval", &Config.ReorderInterval, 0 },
+	{ "Substeps", &Config.Substeps, 1 },
+	{ "RenderStride", &Config.RenderStride, 1 },
+	{ "MinSubsteps", &Config.MinSubsteps, 1 },
+	{ "MaxSubsteps", &Config.MaxSubsteps, 1 },
+	{ "MaxRenderStride", &Config.MaxRenderStride, 1 },
+	{ "MinWorkerCount", &Config.MinWorkerCount, 1 },
+	{ "MaxWorkerCount", &Config.MaxWorkerCount, 0 }
+      };
+
+  for (unsigned int EntryIndex = 0; EntryIndex < sizeof(IntEntries) / sizeof(IntEntries[0]); EntryIndex++)
+    {
+      if (strcmp(Key, IntEntries[EntryIndex].Key) == 0)
+	{
+	  int IntValue = atoi(Value);
+	  if (IntValue < IntEntries[EntryIndex].MinValue)
+	    {
+	      return false;
+	    }
+	  
+	  *IntEntries[EntryIndex].Value = IntValue;
+	  return true;
+	}
+    }
+
+  struct
+  {
+    const char* Key;
+    float* Value;
+  } FloatEntries[] =
+      {
+	{ "CentralMass", &Config.CentralMass },
+	{ "TotalMass", &Config.TotalMass },
+	{ "ScaleRadius", &Config.ScaleRadius },
+	{ "DiskThickness", &Config.DiskThickness },
+	{ "ParticleRadius", &Config.ParticleRadius },
+	{ "GalaxySeparation", &Config.GalaxySeparation },
+	{ "GalaxyApproachSpeed", &Config.GalaxyApproachSpeed },
+	{ "GalaxyInclination", &Config.GalaxyInclination },
+	{ "FrameBudget", &Config.FrameBudget }
+      };
+
+  for (unsigned int EntryIndex = 0; EntryIndex < sizeof(FloatEntries) / sizeof(FloatEntries[0]); EntryIndex++)
+    {
+      if (strcmp(Key, FloatEntries[EntryIndex].Key) == 0)
+	{
+	  *FloatEntries[EntryIndex].Value = atof(Value);
+	  return true;
+	}
+    }
+
+  return false;
+}
+
+// Parses a configuration file's content made of "Key Value" lines. Lines starting with '#' are comments.
+// Rejected lines are reported and ignored. Returns false if any line was rejected.
+bool ParseSimulationConfig(const char* Text, SimulationConfig& Config)
+{
+  bool Succeeded = true;
+  int LineNumber = 0;
+  const char* Line = Text;
+  
+  while (Line != nullptr && *Line != '\0')
+    {
+      LineNumber++;
+      const char* NextLine = strchr(Line, '\n');
+
+      char LineBuffer[256] = {0};
+      size_t LineLength = NextLine != nullptr ? NextLine - Line : strlen(Line);
+      memcpy(LineBuffer, Line, LineLength < sizeof(LineBuffer) - 1 ? LineLength : sizeof(LineBuffer) - 1);
+      
+      char Key[64] = {0};
+      char Value[64] = {0};
+      int ReadFields = sscanf(LineBuffer, "%63s %63s", Key, Value);
+      
+      if (ReadFields >= 1 && Key[0] != '#')
+	{
+	  if (ReadFields < 2 || !SetSimulationConfigValue(Config, Key, Value))
+	    {
+	      printf("WARNING - Ignoring invalid configuration line %d: '%s'.\n", LineNumber, LineBuffer);
+	      Succeeded = false;
+	    }
+	}
+
+      Line = NextLine != nullptr ? NextLine + 1 : nullptr;
+    }
+
+  return Succeeded;
+}
+
+// Fixed point units per unit of acceleration in reproducible mode: 2^40 at most, keeping 19 significant bits to a single
+// unit mass source's pull from a distance of 1. Lowered for heavy sources, so that sums never overflow (see
+// ProcessParticlePhysics).
+#define SIMULATION_FIXED_POINT_SHIFT 40
+
+// Bound on the magnitude of fixed point sums, leaving a factor of 2 to the int64 limit for float rounding of terms.
+#define SIMULATION_FIXED_POINT_SUM_SHIFT 62
+
+typedef void (*ParallelJobFunction)(void* JobData, int JobIndex);
+
+// Particle attracting others during a physics tick.
+struct ParticleSource
+{
+  WorldVector WorldPosition;
+  float Mass;
+  float FixedPointMass; // Mass times the fixed point scale, only set for reproducible ticks.
+  int ParticleIndex;
+};
+
 // Contains all Simulation persistent data and platform layer functions.
 struct SimulationContext
 {
   SimulationInputState InputStates[static_cast<int>(SimulationInputKey::KEY_COUNT)];
+
+  SimulationConfig Config;
   
-  Particle Particles[SIMULATION_PARTICLE_COUNT];
+  Particle* Particles = nullptr;
+  int ParticleCount = 0;
   int TickCount = 0;
+
+  // Current index in Particles of each Particle ID.
+  int* ParticleIndexByID = nullptr;
+
+  // Scratch memory for physics processing, sized like Particles.
+  WorldVector* NewPositions = nullptr;
+  ParticleSource* Sources = nullptr;
+
+  // Scratch memory for reordering, allocated on first reorder.
+  Particle* ReorderedParticles = nullptr;
+  unsigned int* ReorderKeys = nullptr;
+  int* ReorderIndices = nullptr;
+
+  // Reorder costs, reported by the platform layer (e.g. Unix_Metrics.cpp) rather than printed every reorder.
+  int ReorderCount = 0;
+  double LastReorderSeconds = 0;
+  double ReorderSecondsTotal = 0;
+
+  // Statistics of the last tick.
+  int ActiveParticleCount = 0;
+  int SourceParticleCount = 0;
+  long long PairInteractionCount = 0; // Particle pairs whose interaction got evaluated.
+  long long PairInteractionTotal = 0; // Sum of PairInteractionCount over all ticks since initialization.
+  int FixedPointShift = SIMULATION_FIXED_POINT_SHIFT; // Fixed point precision of the last reproducible tick.
+
+  // Quality settings in use, initialized from Config and possibly adjusted at run time by a quality governor.
+  int SubstepCount = 1;
+  int RenderStride = 1;
+
+  Matrix4x4 CameraTransform = Matrix4x4::Identity;
   
   void (*SendParticleRenderCommand)(Matrix4x4 TranformMatrix, ColorRGB Color, float Radius);
   void (*SetViewportMatrix)(Matrix4x4 ViewportMatrix);
   void (*SendExitApplicationCommand)();
+
+  // Monotonic time in seconds, used to measure Simulation stages. Optional.
+  double (*GetWallClockSeconds)() = nullptr;
+
+  // Called at the end of InitializeSimulation with the initial conditions, e.g. as the reference of drift measurements. Optional.
+  void (*RecordInitialState)(const SimulationContext& Context) = nullptr;
+
+  // Runs Job for every index in [0, JobCount) and returns once all of them completed, possibly spreading them across threads.
+  // Left null when the platform layer doesn't provide worker threads: jobs then run serially.
+  void (*RunParallelJobs)(ParallelJobFunction Job, void* JobData, int JobCount) = nullptr;
+
+  void RunJobs(ParallelJobFunction Job, void* JobData, int JobCount)
+  {
+    if (RunParallelJobs != nullptr)
+      {
+	RunParallelJobs(Job, JobData, JobCount);
+	return;
+      }
+    
+    for (int JobIndex = 0; JobIndex < JobCount; JobIndex++)
+      {
+	Job(JobData, JobIndex);
+      }
+  }
   
   bool IsKeyPressed(SimulationInputKey Key) const
   {
@@ -62,6 +337,18 @@ struct SimulationContext
   }
 };
 
+// Summary values describing the physical state of a Simulation at a given tick.
+struct SimulationStatistics
+{
+  int ActiveParticleCount = 0;
+  double TotalMass = 0;
+  double KineticEnergy = 0;
+  double PotentialEnergy = 0;
+  double TotalEnergy = 0;
+  WorldVector Momentum = {0, 0, 0, 0};
+  WorldVector CenterOfMass = {0, 0, 0, 0};
+};
+
 Particle CreateParticle(ColorRGB Color, float Radius, WorldVector Position)
 {
   Particle NewParticle;
@@ -75,90 +362,345 @@ Particle CreateParticle(ColorRGB Color, float Radius, WorldVector Position)
   return NewParticle;
 }
 
+// Particles processed by each physics job.
+#define SIMULATION_PHYSICS_CHUNK_SIZE 1024
+
+struct PhysicsJobData
+{
+  SimulationContext* Context;
+  float TimeDelta;
+  bool IsReproducible;
+  double InverseFixedPointScale;
+  WorldVector* OutNewPositions;
+};
+
+void ProcessParticlePhysicsChunk(void* JobData, int JobIndex)
+{
+  PhysicsJobData& Data = *static_cast<PhysicsJobData*>(JobData);
+  SimulationContext& Context = *Data.Context;
+  const ParticleSource* Sources = Context.Sources;
+  int SourceCount = Context.SourceParticleCount;
+
+  int FirstParticle = JobIndex * SIMULATION_PHYSICS_CHUNK_SIZE;
+  int LastParticle = FirstParticle + SIMULATION_PHYSICS_CHUNK_SIZE;
+  if (LastParticle > Context.ParticleCount)
+    {
+      LastParticle = Context.ParticleCount;
+    }
+  
+  for (int ParticleIndex = FirstParticle; ParticleIndex < LastParticle; ParticleIndex++)
+    {
+      Particle& Part = Context.Particles[ParticleIndex];
+      if (!Part.IsActive)
+	{
+	  Data.OutNewPositions[ParticleIndex] = Part.WorldPosition;
+	  continue;
+	}
+
+      // Accumulated as acceleration rather than force, so that massless tracers need no special case.
+      WorldVector Acceleration;
+      if (Data.IsReproducible)
+	{
+	  // Integer additions being associative, the sum doesn't depend on the order sources get visited in.
+	  // A Particle's own source lies at distance 0 and falls below the cutoff, so it needs no index check here.
+	  long long FixedX = 0, FixedY = 0, FixedZ = 0;
+	  for (int SourceIndex = 0; SourceIndex < SourceCount; SourceIndex++)
+	    {
+	      WorldVector ToSource = Sources[SourceIndex].WorldPosition - Part.WorldPosition;
+	      float DistanceSquared = LengthSquared(ToSource);
+	      float dSquared = DistanceSquared * 1000;
+	      if (dSquared > 1)
+		{
+		  // Normalization and force law folded into a single division.
+		  float Factor = Sources[SourceIndex].FixedPointMass / (dSquared * sqrtf(DistanceSquared));
+		  FixedX += static_cast<long long>(ToSource.x * Factor);
+		  FixedY += static_cast<long long>(ToSource.y * Factor);
+		  FixedZ += static_cast<long long>(ToSource.z * Factor);
+		}
+	    }
+
+	  // The scale being a power of 2, multiplying by its inverse is exact.
+	  Acceleration = {static_cast<float>(FixedX * Data.InverseFixedPointScale), static_cast<float>(FixedY * Data.InverseFixedPointScale),
+			  static_cast<float>(FixedZ * Data.InverseFixedPointScale), 1};
+	}
+      else
+	{
+	  for (int SourceIndex = 0; SourceIndex < SourceCount; SourceIndex++)
+	    {
+	      if (Sources[SourceIndex].ParticleIndex == ParticleIndex)
+		{
+		  continue;
+		}
+
+	      WorldVector ToSource = Sources[SourceIndex].WorldPosition - Part.WorldPosition;
+	      float dSquared = LengthSquared(ToSource) * 1000;
+	      if (dSquared > 1)
+		{
+		  Acceleration = Acceleration + NormalizeVector(ToSource) * (Sources[SourceIndex].Mass / dSquared);
+		}
+	    }
+	}
+
+      Part.Velocity = Part.Velocity + Acceleration * Data.TimeDelta;
+      Data.OutNewPositions[ParticleIndex] = Part.WorldPosition + Part.Velocity * Data.TimeDelta;
+    }
+}
+
 // Returns new World Position of all Particles.
+// Every active Particle is attracted by every active non tracer Particle, gathered beforehand in Context.Sources.
 void ProcessParticlePhysics(SimulationContext& Context, float TimeDelta, WorldVector* OutNewPositions)
 { 
-  WorldVector NewPositions[SIMULATION_PARTICLE_COUNT];
-  memset(NewPositions, 0, sizeof(NewPositions));
-    
-  for (int ParticleIndex = 0; ParticleIndex < SIMULATION_PARTICLE_COUNT; ParticleIndex++)
+  long long ActiveParticleCount = 0;
+  long long SourceCount = 0;
+  float MaxSourceMass = 0;
+  
+  for (int ParticleIndex = 0; ParticleIndex < Context.ParticleCount; ParticleIndex++)
     {
-      if (!Context.Particles[ParticleIndex].IsActive)
+      const Particle& Part = Context.Particles[ParticleIndex];
+      if (!Part.IsActive)
 	{
 	  continue;
 	}
 
-      WorldVector Velocity = Context.Particles[ParticleIndex].Velocity;
-    
-      WorldVector TotalGravForce;
-      for(int OtherParticleIndex = 0; OtherParticleIndex < SIMULATION_PARTICLE_COUNT; OtherParticleIndex++)
+      ActiveParticleCount++;
+      if (!Part.IsTracer)
+	{
+	  Context.Sources[SourceCount].WorldPosition = Part.WorldPosition;
+	  Context.Sources[SourceCount].Mass = Part.Mass;
+	  Context.Sources[SourceCount].ParticleIndex = ParticleIndex;
+	  SourceCount++;
+	  MaxSourceMass = fabsf(Part.Mass) > MaxSourceMass ? fabsf(Part.Mass) : MaxSourceMass;
+	}
+    }
+  
+  Context.ActiveParticleCount = static_cast<int>(ActiveParticleCount);
+  Context.SourceParticleCount = static_cast<int>(SourceCount);
+  Context.PairInteractionCount = ActiveParticleCount * SourceCount - SourceCount; // Sources skip themselves.
+  Context.PairInteractionTotal += Context.PairInteractionCount;
+
+  PhysicsJobData Data;
+  Data.Context = &Context;
+  Data.TimeDelta = TimeDelta;
+  Data.IsReproducible = Context.Config.ReproducibleForces;
+  Data.InverseFixedPointScale = 1;
+
+  if (Data.IsReproducible)
+    {
+      int Shift = SIMULATION_FIXED_POINT_SHIFT;
+      if (SourceCount > 0 && MaxSourceMass > 0)
+	{
+	  // The cutoff keeps dSquared above 1, so no term exceeds its source's mass and no sum exceeds
+	  // MaxSourceMass * SourceCount. Both are independent of Particles' order, and so is the resulting scale.
+	  int BoundExponent;
+	  frexp(static_cast<double>(MaxSourceMass) * SourceCount, &BoundExponent); // Bound < 2^BoundExponent.
+	  Shift = SIMULATION_FIXED_POINT_SUM_SHIFT - BoundExponent;
+	  Shift = Shift < SIMULATION_FIXED_POINT_SHIFT ? Shift : SIMULATION_FIXED_POINT_SHIFT;
+	}
+      Context.FixedPointShift = Shift; // Reported by the platform layer, as precision may drop every tick.
+
+      // Scaling masses once per tick rather than once per interaction.
+      float FixedPointScale = ldexpf(1.f, Shift);
+      for (int SourceIndex = 0; SourceIndex < SourceCount; SourceIndex++)
 	{
-	  if (!Context.Particles[OtherParticleIndex].IsActive || ParticleIndex == OtherParticleIndex)
+	  Context.Sources[SourceIndex].FixedPointMass = Context.Sources[SourceIndex].Mass * FixedPointScale;
+	}
+      Data.InverseFixedPointScale = ldexp(1., -Shift);
+    }
+  Data.OutNewPositions = OutNewPositions;
+  
+  int ChunkCount = (Context.ParticleCount + SIMULATION_PHYSICS_CHUNK_SIZE - 1) / SIMULATION_PHYSICS_CHUNK_SIZE;
+  Context.RunJobs(ProcessParticlePhysicsChunk, &Data, ChunkCount);
+}
+
+#include "ParticleScenarios.cpp"
+#include "ParticleReordering.cpp"
+#include "ParticleQualityGovernor.cpp"
+
+// Releases memory allocated by InitializeSimulation. The Context can be initialized again afterwards.
+void ShutdownSimulation(SimulationContext& Context)
+{
+  free(Context.Particles);
+  free(Context.ParticleIndexByID);
+  free(Context.NewPositions);
+  free(Context.Sources);
+  free(Context.ReorderedParticles);
+  free(Context.ReorderKeys);
+  free(Context.ReorderIndices);
+  
+  Context.Particles = nullptr;
+  Context.ParticleIndexByID = nullptr;
+  Context.NewPositions = nullptr;
+  Context.Sources = nullptr;
+  Context.ReorderedParticles = nullptr;
+  Context.ReorderKeys = nullptr;
+  Context.ReorderIndices = nullptr;
+  Context.ParticleCount = 0;
+  Context.TickCount = 0;
+  Context.PairInteractionTotal = 0;
+  Context.FixedPointShift = SIMULATION_FIXED_POINT_SHIFT;
+}
+
+// Allocates and creates the initial set of Particles from the Context's configuration. Returns false if memory ran out,
+// leaving the Context without Particles.
+bool InitializeSimulation(SimulationContext& Context)
+{
+  ShutdownSimulation(Context);
+
+  Context.ParticleCount = Context.Config.ParticleCount;
+  Context.Particles = static_cast<Particle*>(malloc(Context.ParticleCount * sizeof(Particle)));
+  Context.ParticleIndexByID = static_cast<int*>(malloc(Context.ParticleCount * sizeof(int)));
+  Context.NewPositions = static_cast<WorldVector*>(malloc(Context.ParticleCount * sizeof(WorldVector)));
+  Context.Sources = static_cast<ParticleSource*>(malloc(Context.ParticleCount * sizeof(ParticleSource)));
+
+  if (Context.Particles == nullptr || Context.ParticleIndexByID == nullptr || Context.NewPositions == nullptr || Context.Sources == nullptr)
+    {
+      printf("ERROR - Couldn't allocate memory for %d particles !\n", Context.ParticleCount);
+      ShutdownSimulation(Context);
+      return false;
+    }
+
+  GenerateScenario(Context);
+
+  Context.SubstepCount = Context.Config.Substeps;
+  Context.RenderStride = Context.Config.RenderStride;
+
+  for (int ParticleIndex = 0; ParticleIndex < Context.ParticleCount; ParticleIndex++)
+    {
+      Context.ParticleIndexByID[ParticleIndex] = ParticleIndex;
+    }
+
+  Context.TickCount = 1;
+
+  if (Context.RecordInitialState != nullptr)
+    {
+      Context.RecordInitialState(Context);
+    }
+
+  return true;
+}
+
+// Advances the physical state of the Simulation by one tick, without any rendering or input handling.
+void StepSimulation(SimulationContext& Context, float TimeDelta)
+{
+  if (Context.Config.ReorderInterval > 0 && Context.TickCount % Context.Config.ReorderInterval == 0)
+    {
+      ReorderParticles(Context);
+    }
+  
+  ProcessParticlePhysics(Context, TimeDelta, Context.NewPositions);
+
+  // Update particle positions after physics tick.
+
+  for(int ParticleIndex = 0; ParticleIndex < Context.ParticleCount; ParticleIndex++)
+    {
+      Context.Particles[ParticleIndex].WorldPosition = Context.NewPositions[ParticleIndex];
+    }
+
+  Context.TickCount++;
+}
+
+// Computes energy, momentum and mass distribution of all active Particles in the array.
+// Potential energy follows the same force law and cutoff as ProcessParticlePhysics. Tracers being massless, only pairs of
+// sources contribute to it. When AreSourcesFirst, no source follows a tracer in the array: pairs then cost
+// O(Sources^2) instead of O(Sources * ParticleCount).
+SimulationStatistics ComputeParticleStatistics(const Particle* Particles, int ParticleCount, bool AreSourcesFirst)
+{
+  SimulationStatistics Stats;
+  double MomentumX = 0, MomentumY = 0, MomentumZ = 0;
+  double WeightedX = 0, WeightedY = 0, WeightedZ = 0;
+  
+  for (int ParticleIndex = 0; ParticleIndex < ParticleCount; ParticleIndex++)
+    {
+      const Particle& Part = Particles[ParticleIndex];
+      if (!Part.IsActive)
+	{
+	  continue;
+	}
+
+      Stats.ActiveParticleCount++;
+      Stats.TotalMass += Part.Mass;
+      Stats.KineticEnergy += 0.5 * Part.Mass * LengthSquared(Part.Velocity);
+
+      MomentumX += Part.Mass * Part.Velocity.x;
+      MomentumY += Part.Mass * Part.Velocity.y;
+      MomentumZ += Part.Mass * Part.Velocity.z;
+
+      WeightedX += Part.Mass * Part.WorldPosition.x;
+      WeightedY += Part.Mass * Part.WorldPosition.y;
+      WeightedZ += Part.Mass * Part.WorldPosition.z;
+
+      if (Part.IsTracer)
+	{
+	  continue;
+	}
+
+      for (int OtherParticleIndex = ParticleIndex + 1; OtherParticleIndex < ParticleCount; OtherParticleIndex++)
+	{
+	  const Particle& Other = Particles[OtherParticleIndex];
+	  if (Other.IsTracer && AreSourcesFirst)
+	    {
+	      break;
+	    }
+	  if (!Other.IsActive || Other.IsTracer)
 	    {
 	      continue;
 	    }
 
-	  WorldVector ToOther = Context.Particles[OtherParticleIndex].WorldPosition - Context.Particles[ParticleIndex].WorldPosition;
-	  float dSquared = LengthSquared(ToOther) * 1000;
-	  if (dSquared > 1)
+	  float DistanceSquared = LengthSquared(Other.WorldPosition - Part.WorldPosition);
+	  if (DistanceSquared * 1000 > 1)
 	    {
-	      WorldVector GravForce = NormalizeVector(ToOther) * (Context.Particles[ParticleIndex].Mass * Context.Particles[OtherParticleIndex].Mass / dSquared);
-
-	      TotalGravForce = TotalGravForce + GravForce;
+	      Stats.PotentialEnergy -= Part.Mass * Other.Mass / (1000 * sqrt(DistanceSquared));
 	    }
 	}
+    }
 
-      Velocity = Velocity + (TotalGravForce / Context.Particles[ParticleIndex].Mass * TimeDelta);
-      
-      WorldVector NewPosition = Context.Particles[ParticleIndex].WorldPosition + Velocity * TimeDelta; 
-      OutNewPositions[ParticleIndex] = NewPosition;
-      Context.Particles[ParticleIndex].Velocity = Velocity;
+  Stats.TotalEnergy = Stats.KineticEnergy + Stats.PotentialEnergy;
+  Stats.Momentum = {static_cast<float>(MomentumX), static_cast<float>(MomentumY), static_cast<float>(MomentumZ), 0};
+  if (Stats.TotalMass > 0)
+    {
+      Stats.CenterOfMass = {static_cast<float>(WeightedX / Stats.TotalMass),
+			    static_cast<float>(WeightedY / Stats.TotalMass),
+			    static_cast<float>(WeightedZ / Stats.TotalMass), 1};
     }
+  
+  return Stats;
+}
+
+SimulationStatistics ComputeSimulationStatistics(const SimulationContext& Context)
+{
+  return ComputeParticleStatistics(Context.Particles, Context.ParticleCount, false);
 }
 
 void RunSimulation(SimulationContext& Context, float TimeDelta)
 {
   if (Context.TickCount == 0)
     {
-      Context.Particles[0] = CreateParticle({1, 0, 1}, 0.05f, {0, 0, 0, 1});
-      Context.Particles[0].Mass = 500;
-
-      for(int ParticleIndex = 1; ParticleIndex < SIMULATION_PARTICLE_COUNT; ParticleIndex++)
+      if (!InitializeSimulation(Context))
 	{
-	  ColorRGB PartCol;
-	  WorldVector PartPos;
-	  WorldVector PartVel;
-	  
-	  PartCol = {1, 0, 0};
-	  PartPos = {0, (rand() % 100 - 50) / 100.f, (rand() % 100 - 50) / 100.f};
-	  PartVel = {0, (rand() % 100 - 50) / 100.f * 1, (rand() % 100 - 50) / 100.f * 1};
-	  
-	  Context.Particles[ParticleIndex] = CreateParticle(PartCol, 0.01f, PartPos);
-	  Context.Particles[ParticleIndex].Velocity = PartVel;
+	  Context.SendExitApplicationCommand();
 	}
-
-      Context.TickCount = 1;
       return;
     }
   
-  WorldVector NewPositions[SIMULATION_PARTICLE_COUNT];
-  ProcessParticlePhysics(Context, TimeDelta, NewPositions);
-
-  // Update particle positions after physics tick.
-
-  for(int ParticleIndex = 0; ParticleIndex < SIMULATION_PARTICLE_COUNT; ParticleIndex++)
+  for (int Substep = 0; Substep < Context.SubstepCount; Substep++)
     {
-      Context.Particles[ParticleIndex].WorldPosition = NewPositions[ParticleIndex];
+      StepSimulation(Context, TimeDelta / Context.SubstepCount);
     }
   
-  // Draw all active Particles.
-  for (int ParticleIndex = 0; ParticleIndex < SIMULATION_PARTICLE_COUNT; ParticleIndex++)
+  // Draw all active Particles, or one in RenderStride. Both selection and submission order go by ID so that reordering Particles
+  // changes neither what gets drawn nor which of two Particles at the same depth wins the depth test.
+  bool HasTracers = Context.SourceParticleCount < Context.ActiveParticleCount;
+  for (int ParticleID = 0; ParticleID < Context.ParticleCount; ParticleID++)
     {
-      Particle& Part = Context.Particles[ParticleIndex];
+      Particle& Part = Context.Particles[Context.ParticleIndexByID[ParticleID]];
       if (!Part.IsActive)
 	{
 	  continue;
 	}
+      if (Context.RenderStride > 1 && (Part.IsTracer || !HasTracers) && Part.ID % Context.RenderStride != 0)
+	{
+	  continue;
+	}
 
       Matrix4x4 ParticleMatrix = Matrix4x4::Identity;
       ParticleMatrix.SetTranslation(Part.WorldPosition);
@@ -167,8 +709,6 @@ void RunSimulation(SimulationContext& Context, float TimeDelta)
       Context.SendParticleRenderCommand(ParticleMatrix, Part.Color, Part.Radius); 
     }
 
-  static Matrix4x4 CameraTransform = Matrix4x4::Identity;
-
   WorldVector CameraMovementVector = WorldVector::ZeroVector;
   
   if (Context.IsKeyPressed(SimulationInputKey::Z))
@@ -192,8 +732,6 @@ void RunSimulation(SimulationContext& Context, float TimeDelta)
       Context.SendExitApplicationCommand();
     }
   
-  CameraTransform.AddTranslation(CameraMovementVector * TimeDelta * 2);
-  Context.SetViewportMatrix(CameraTransform);
-  
-  Context.TickCount++;
+  Context.CameraTransform.AddTranslation(CameraMovementVector * TimeDelta * 2);
+  Context.SetViewportMatrix(Context.CameraTransform);
 }
@@ -0,0 +1,9 @@
+// Render commands sent by the Simulation through SimulationContext::SendParticleRenderCommand.
+// Shared by all render backends (OpenGL, Software).
+
+struct ParticleRenderCommand
+{
+  Matrix4x4 WorldTransform; // 4x4 World Transform Matrix
+  ColorRGB Color;
+  float Radius;
+};
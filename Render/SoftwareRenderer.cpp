@@ -0,0 +1,384 @@
+// CPU particle renderer, for machines without a display server or OpenGL.
+// Follows the same render path as OpenGL_DrawParticles + VertexShader.shader: each Particle is a screen facing square
+// of side Radius, moved into view space by subtracting the viewport translation, with axes swizzled (x, y, z) -> (y, z, x)
+// and x/y divided by 1 + depth / 50. Particles whose view space depth falls outside [-1, 1] are clipped like by OpenGL.
+//
+// The frame is split into tiles. Particles are projected in parallel, copied into the bins of the tiles they overlap
+// (keeping submission order), then every tile gets rasterized by one job reading its bin sequentially and drawing into
+// tile local buffers that stay in cache. Binning is a counting sort split like the radix sort of ParticleReordering.cpp:
+// each projection job counts the splats of its chunk per tile, the counts become per chunk insertion offsets, then every
+// chunk scatters its splats independently.
+// Requires ParticleSimulation.cpp and Render/RenderCommands.h to be included beforehand.
+
+#define SOFTWARE_RENDER_TILE_SIZE 64
+#define SOFTWARE_RENDER_PROJECTION_CHUNK_SIZE 8192
+
+enum class SoftwareRenderMode
+  {
+    DEPTH_TESTED, // Opaque particles, nearest one wins. Same output as the OpenGL path.
+    ADDITIVE,     // Particle colors add up, without depth test.
+    DENSITY       // Number of particles covering each pixel, tone mapped to a heat palette.
+  };
+
+// Screen space rectangle covered by a particle, in pixels. Max bounds are exclusive.
+struct SoftwareSplat
+{
+  int MinX, MinY, MaxX, MaxY;
+  float Depth;
+  ColorRGB Color;
+};
+
+struct SoftwareRenderer
+{
+  int Width = 0;
+  int Height = 0;
+  SoftwareRenderMode Mode = SoftwareRenderMode::DEPTH_TESTED;
+  ColorRGB ClearColor = {0.1f, 0.3f, 0.6f};
+  float Intensity = 0.25f; // Scale applied to each particle's contribution in ADDITIVE and DENSITY modes.
+
+  // Output, 3 bytes (RGB) per pixel, top row first.
+  unsigned char* Pixels = nullptr;
+
+  int TileCountX = 0;
+  int TileCountY = 0;
+
+  // Per frame data, grown as needed.
+  SoftwareSplat* Splats = nullptr;
+  int SplatCapacity = 0;
+  int* TileSplatOffsets = nullptr; // TileCountX * TileCountY + 1 entries. Splats of tile T are BinnedSplats[Offsets[T]..Offsets[T + 1]).
+  SoftwareSplat* BinnedSplats = nullptr;
+  int BinnedSplatCapacity = 0;
+  int* ChunkTileOffsets = nullptr; // Per projection chunk and tile: splat count, then insertion cursor into BinnedSplats.
+  int ChunkTileOffsetCapacity = 0;
+
+  // Same contract as SimulationContext::RunParallelJobs. Jobs run serially when null.
+  void (*RunParallelJobs)(ParallelJobFunction Job, void* JobData, int JobCount) = nullptr;
+};
+
+bool InitializeSoftwareRenderer(SoftwareRenderer& Renderer, int Width, int Height, SoftwareRenderMode Mode)
+{
+  Renderer.Width = Width;
+  Renderer.Height = Height;
+  Renderer.Mode = Mode;
+  Renderer.TileCountX = (Width + SOFTWARE_RENDER_TILE_SIZE - 1) / SOFTWARE_RENDER_TILE_SIZE;
+  Renderer.TileCountY = (Height + SOFTWARE_RENDER_TILE_SIZE - 1) / SOFTWARE_RENDER_TILE_SIZE;
+
+  Renderer.Pixels = static_cast<unsigned char*>(malloc(static_cast<size_t>(Width) * Height * 3));
+  Renderer.TileSplatOffsets = static_cast<int*>(malloc((Renderer.TileCountX * Renderer.TileCountY + 1) * sizeof(int)));
+
+  return Renderer.Pixels != nullptr && Renderer.TileSplatOffsets != nullptr;
+}
+
+void ShutdownSoftwareRenderer(SoftwareRenderer& Renderer)
+{
+  free(Renderer.Pixels);
+  free(Renderer.Splats);
+  free(Renderer.TileSplatOffsets);
+  free(Renderer.BinnedSplats);
+  free(Renderer.ChunkTileOffsets);
+
+  Renderer = SoftwareRenderer();
+}
+
+void RunSoftwareRendererJobs(SoftwareRenderer& Renderer, ParallelJobFunction Job, void* JobData, int JobCount)
+{
+  if (Renderer.RunParallelJobs != nullptr)
+    {
+      Renderer.RunParallelJobs(Job, JobData, JobCount);
+      return;
+    }
+
+  for (int JobIndex = 0; JobIndex < JobCount; JobIndex++)
+    {
+      Job(JobData, JobIndex);
+    }
+}
+
+struct SoftwareRenderFrameData
+{
+  SoftwareRenderer* Renderer;
+  const ParticleRenderCommand* Commands;
+  int CommandCount;
+  WorldVector ViewportTranslation;
+};
+
+// Projects a range of render commands into splats and counts how many of them overlap each tile.
+// Clipped particles get an empty rectangle.
+void ProjectSoftwareSplats(void* JobData, int JobIndex)
+{
+  SoftwareRenderFrameData& Frame = *static_cast<SoftwareRenderFrameData*>(JobData);
+  SoftwareRenderer& Renderer = *Frame.Renderer;
+  int* TileCounts = Renderer.ChunkTileOffsets + JobIndex * Renderer.TileCountX * Renderer.TileCountY;
+  memset(TileCounts, 0, Renderer.TileCountX * Renderer.TileCountY * sizeof(int));
+
+  int FirstCommand = JobIndex * SOFTWARE_RENDER_PROJECTION_CHUNK_SIZE;
+  int LastCommand = FirstCommand + SOFTWARE_RENDER_PROJECTION_CHUNK_SIZE;
+  if (LastCommand > Frame.CommandCount)
+    {
+      LastCommand = Frame.CommandCount;
+    }
+
+  float WidthToHeightRatio = static_cast<float>(Renderer.Width) / Renderer.Height;
+
+  for (int CommandIndex = FirstCommand; CommandIndex < LastCommand; CommandIndex++)
+    {
+      const ParticleRenderCommand& Command = Frame.Commands[CommandIndex];
+      SoftwareSplat& Splat = Renderer.Splats[CommandIndex];
+      Splat.MinX = Splat.MaxX = Splat.MinY = Splat.MaxY = 0;
+
+      // View space position of the particle's center, then VertexShader.shader's swizzle.
+      float ViewX = Command.WorldTransform[0][3] - Frame.ViewportTranslation.x;
+      float ViewY = Command.WorldTransform[1][3] - Frame.ViewportTranslation.y;
+      float ViewZ = Command.WorldTransform[2][3] - Frame.ViewportTranslation.z;
+
+      float ScreenX = ViewY;
+      float ScreenY = ViewZ;
+      float Depth = ViewX;
+      if (Depth < -1.f || Depth > 1.f)
+	{
+	  continue;
+	}
+
+      float DepthRatio = 1.f / (1.f + Depth / 50.f);
+      float CenterX = ScreenX / WidthToHeightRatio * DepthRatio;
+      float CenterY = ScreenY * DepthRatio;
+      float HalfExtentX = 0.5f * Command.WorldTransform[1][1] / WidthToHeightRatio * DepthRatio;
+      float HalfExtentY = 0.5f * Command.WorldTransform[2][2] * DepthRatio;
+
+      // Normalized device coordinates to pixels, top row first.
+      float PixelMinX = (CenterX - HalfExtentX + 1.f) * 0.5f * Renderer.Width;
+      float PixelMaxX = (CenterX + HalfExtentX + 1.f) * 0.5f * Renderer.Width;
+      float PixelMinY = (1.f - (CenterY + HalfExtentY)) * 0.5f * Renderer.Height;
+      float PixelMaxY = (1.f - (CenterY - HalfExtentY)) * 0.5f * Renderer.Height;
+
+      // Cover pixels whose center lies in the square. Unlike OpenGL, a particle always covers at least the pixel its
+      // center falls into, so that tiny particles still show up in additive and density modes.
+      int MinX = static_cast<int>(ceilf(PixelMinX - 0.5f));
+      int MaxX = static_cast<int>(ceilf(PixelMaxX - 0.5f));
+      int MinY = static_cast<int>(ceilf(PixelMinY - 0.5f));
+      int MaxY = static_cast<int>(ceilf(PixelMaxY - 0.5f));
+      if (MaxX <= MinX)
+	{
+	  MinX = static_cast<int>(floorf((PixelMinX + PixelMaxX) * 0.5f));
+	  MaxX = MinX + 1;
+	}
+      if (MaxY <= MinY)
+	{
+	  MinY = static_cast<int>(floorf((PixelMinY + PixelMaxY) * 0.5f));
+	  MaxY = MinY + 1;
+	}
+
+      MinX = MinX < 0 ? 0 : MinX;
+      MinY = MinY < 0 ? 0 : MinY;
+      MaxX = MaxX > Renderer.Width ? Renderer.Width : MaxX;
+      MaxY = MaxY > Renderer.Height ? Renderer.Height : MaxY;
+      if (MinX >= MaxX || MinY >= MaxY)
+	{
+	  continue;
+	}
+
+      Splat.MinX = MinX;
+      Splat.MinY = MinY;
+      Splat.MaxX = MaxX;
+      Splat.MaxY = MaxY;
+      Splat.Depth = Depth;
+      Splat.Color = Command.Color;
+
+      for (int TileY = MinY / SOFTWARE_RENDER_TILE_SIZE; TileY <= (MaxY - 1) / SOFTWARE_RENDER_TILE_SIZE; TileY++)
+	{
+	  for (int TileX = MinX / SOFTWARE_RENDER_TILE_SIZE; TileX <= (MaxX - 1) / SOFTWARE_RENDER_TILE_SIZE; TileX++)
+	    {
+	      TileCounts[TileY * Renderer.TileCountX + TileX]++;
+	    }
+	}
+    }
+}
+
+// Copies the splats of a projection chunk into the bins of the tiles they overlap, from the chunk's insertion offsets.
+void BinSoftwareSplats(void* JobData, int JobIndex)
+{
+  SoftwareRenderFrameData& Frame = *static_cast<SoftwareRenderFrameData*>(JobData);
+  SoftwareRenderer& Renderer = *Frame.Renderer;
+  int* TileCursors = Renderer.ChunkTileOffsets + JobIndex * Renderer.TileCountX * Renderer.TileCountY;
+
+  int FirstSplat = JobIndex * SOFTWARE_RENDER_PROJECTION_CHUNK_SIZE;
+  int LastSplat = FirstSplat + SOFTWARE_RENDER_PROJECTION_CHUNK_SIZE;
+  if (LastSplat > Frame.CommandCount)
+    {
+      LastSplat = Frame.CommandCount;
+    }
+
+  for (int SplatIndex = FirstSplat; SplatIndex < LastSplat; SplatIndex++)
+    {
+      const SoftwareSplat& Splat = Renderer.Splats[SplatIndex];
+      if (Splat.MinX >= Splat.MaxX)
+	{
+	  continue;
+	}
+
+      for (int TileY = Splat.MinY / SOFTWARE_RENDER_TILE_SIZE; TileY <= (Splat.MaxY - 1) / SOFTWARE_RENDER_TILE_SIZE; TileY++)
+	{
+	  for (int TileX = Splat.MinX / SOFTWARE_RENDER_TILE_SIZE; TileX <= (Splat.MaxX - 1) / SOFTWARE_RENDER_TILE_SIZE; TileX++)
+	    {
+	      Renderer.BinnedSplats[TileCursors[TileY * Renderer.TileCountX + TileX]++] = Splat;
+	    }
+	}
+    }
+}
+
+static unsigned char ToColorByte(float Value)
+{
+  Value = Value < 0.f ? 0.f : (Value > 1.f ? 1.f : Value);
+  return static_cast<unsigned char>(Value * 255.f + 0.5f);
+}
+
+// Black -> red -> yellow -> white palette for DENSITY mode, Value in [0, 1].
+static ColorRGB HeatPalette(float Value)
+{
+  return {Value * 3.f, Value * 3.f - 1.f, Value * 3.f - 2.f};
+}
+
+// Rasterizes all splats binned into one tile and writes the tile's final pixels.
+void RasterizeSoftwareTile(void* JobData, int TileIndex)
+{
+  SoftwareRenderFrameData& Frame = *static_cast<SoftwareRenderFrameData*>(JobData);
+  SoftwareRenderer& Renderer = *Frame.Renderer;
+
+  int TileMinX = (TileIndex % Renderer.TileCountX) * SOFTWARE_RENDER_TILE_SIZE;
+  int TileMinY = (TileIndex / Renderer.TileCountX) * SOFTWARE_RENDER_TILE_SIZE;
+  int TileWidth = Renderer.Width - TileMinX < SOFTWARE_RENDER_TILE_SIZE ? Renderer.Width - TileMinX : SOFTWARE_RENDER_TILE_SIZE;
+  int TileHeight = Renderer.Height - TileMinY < SOFTWARE_RENDER_TILE_SIZE ? Renderer.Height - TileMinY : SOFTWARE_RENDER_TILE_SIZE;
+
+  // Tile local buffers. DEPTH_TESTED: Color holds particle colors and Depth is tested against.
+  // ADDITIVE: Color accumulates contributions. DENSITY: Depth is used as a coverage counter.
+  ColorRGB Color[SOFTWARE_RENDER_TILE_SIZE * SOFTWARE_RENDER_TILE_SIZE];
+  float Depth[SOFTWARE_RENDER_TILE_SIZE * SOFTWARE_RENDER_TILE_SIZE];
+
+  bool IsDepthTested = Renderer.Mode == SoftwareRenderMode::DEPTH_TESTED;
+  ColorRGB InitialColor = IsDepthTested ? Renderer.ClearColor : ColorRGB {0, 0, 0};
+  float InitialDepth = IsDepthTested ? 1.f : 0.f;
+  for (int PixelIndex = 0; PixelIndex < SOFTWARE_RENDER_TILE_SIZE * SOFTWARE_RENDER_TILE_SIZE; PixelIndex++)
+    {
+      Color[PixelIndex] = InitialColor;
+      Depth[PixelIndex] = InitialDepth;
+    }
+
+  for (int BinIndex = Renderer.TileSplatOffsets[TileIndex]; BinIndex < Renderer.TileSplatOffsets[TileIndex + 1]; BinIndex++)
+    {
+      const SoftwareSplat& Splat = Renderer.BinnedSplats[BinIndex];
+
+      int MinX = (Splat.MinX > TileMinX ? Splat.MinX : TileMinX) - TileMinX;
+      int MinY = (Splat.MinY > TileMinY ? Splat.MinY : TileMinY) - TileMinY;
+      int MaxX = (Splat.MaxX < TileMinX + TileWidth ? Splat.MaxX : TileMinX + TileWidth) - TileMinX;
+      int MaxY = (Splat.MaxY < TileMinY + TileHeight ? Splat.MaxY : TileMinY + TileHeight) - TileMinY;
+
+      for (int y = MinY; y < MaxY; y++)
+	{
+	  int RowStart = y * SOFTWARE_RENDER_TILE_SIZE;
+	  switch(Renderer.Mode)
+	    {
+	    case(SoftwareRenderMode::DEPTH_TESTED):
+	      for (int x = MinX; x < MaxX; x++)
+		{
+		  // GL_LESS, like the default OpenGL depth test: on equal depth the first submitted particle stays.
+		  if (Splat.Depth < Depth[RowStart + x])
+		    {
+		      Depth[RowStart + x] = Splat.Depth;
+		      Color[RowStart + x] = Splat.Color;
+		    }
+		}
+	      break;
+	    case(SoftwareRenderMode::ADDITIVE):
+	      for (int x = MinX; x < MaxX; x++)
+		{
+		  Color[RowStart + x].r += Splat.Color.r;
+		  Color[RowStart + x].g += Splat.Color.g;
+		  Color[RowStart + x].b += Splat.Color.b;
+		}
+	      break;
+	    case(SoftwareRenderMode::DENSITY):
+	      for (int x = MinX; x < MaxX; x++)
+		{
+		  Depth[RowStart + x] += 1.f;
+		}
+	      break;
+	    }
+	}
+    }
+
+  // Resolve tile into the output image.
+  for (int y = 0; y < TileHeight; y++)
+    {
+      unsigned char* OutputRow = Renderer.Pixels + (static_cast<size_t>(TileMinY + y) * Renderer.Width + TileMinX) * 3;
+      for (int x = 0; x < TileWidth; x++)
+	{
+	  ColorRGB PixelColor = Color[y * SOFTWARE_RENDER_TILE_SIZE + x];
+	  if (Renderer.Mode == SoftwareRenderMode::ADDITIVE)
+	    {
+	      PixelColor = {Renderer.ClearColor.r + PixelColor.r * Renderer.Intensity,
+			    Renderer.ClearColor.g + PixelColor.g * Renderer.Intensity,
+			    Renderer.ClearColor.b + PixelColor.b * Renderer.Intensity};
+	    }
+	  else if (Renderer.Mode == SoftwareRenderMode::DENSITY)
+	    {
+	      PixelColor = HeatPalette(1.f - expf(-Depth[y * SOFTWARE_RENDER_TILE_SIZE + x] * Renderer.Intensity));
+	    }
+
+	  OutputRow[x * 3 + 0] = ToColorByte(PixelColor.r);
+	  OutputRow[x * 3 + 1] = ToColorByte(PixelColor.g);
+	  OutputRow[x * 3 + 2] = ToColorByte(PixelColor.b);
+	}
+    }
+}
+
+// Renders all commands into Renderer.Pixels. ViewportMatrix is the one last sent through SetViewportMatrix.
+void SoftwareRenderParticles(SoftwareRenderer& Renderer, const ParticleRenderCommand* Commands, int CommandCount, Matrix4x4 ViewportMatrix)
+{
+  if (CommandCount > Renderer.SplatCapacity)
+    {
+      Renderer.SplatCapacity = CommandCount;
+      Renderer.Splats = static_cast<SoftwareSplat*>(realloc(Renderer.Splats, CommandCount * sizeof(SoftwareSplat)));
+    }
+
+  SoftwareRenderFrameData Frame;
+  Frame.Renderer = &Renderer;
+  Frame.Commands = Commands;
+  Frame.CommandCount = CommandCount;
+  Frame.ViewportTranslation = ViewportMatrix.GetTranslation();
+
+  int ProjectionJobCount = (CommandCount + SOFTWARE_RENDER_PROJECTION_CHUNK_SIZE - 1) / SOFTWARE_RENDER_PROJECTION_CHUNK_SIZE;
+  int TileCount = Renderer.TileCountX * Renderer.TileCountY;
+  if (ProjectionJobCount * TileCount > Renderer.ChunkTileOffsetCapacity)
+    {
+      Renderer.ChunkTileOffsetCapacity = ProjectionJobCount * TileCount;
+      Renderer.ChunkTileOffsets = static_cast<int*>(realloc(Renderer.ChunkTileOffsets, Renderer.ChunkTileOffsetCapacity * sizeof(int)));
+    }
+
+  RunSoftwareRendererJobs(Renderer, ProjectSoftwareSplats, &Frame, ProjectionJobCount);
+
+  // Turn per chunk counts into insertion offsets: tile by tile, then chunk by chunk within a tile, which keeps submission
+  // order within each bin.
+  int BinnedSplatCount = 0;
+  for (int TileIndex = 0; TileIndex < TileCount; TileIndex++)
+    {
+      Renderer.TileSplatOffsets[TileIndex] = BinnedSplatCount;
+      for (int ChunkIndex = 0; ChunkIndex < ProjectionJobCount; ChunkIndex++)
+	{
+	  int& ChunkTileOffset = Renderer.ChunkTileOffsets[ChunkIndex * TileCount + TileIndex];
+	  int ChunkTileCount = ChunkTileOffset;
+	  ChunkTileOffset = BinnedSplatCount;
+	  BinnedSplatCount += ChunkTileCount;
+	}
+    }
+  Renderer.TileSplatOffsets[TileCount] = BinnedSplatCount;
+
+  if (BinnedSplatCount > Renderer.BinnedSplatCapacity)
+    {
+      Renderer.BinnedSplatCapacity = BinnedSplatCount + BinnedSplatCount / 4;
+      Renderer.BinnedSplats = static_cast<SoftwareSplat*>(realloc(Renderer.BinnedSplats, Renderer.BinnedSplatCapacity * sizeof(SoftwareSplat)));
+    }
+
+  RunSoftwareRendererJobs(Renderer, BinSoftwareSplats, &Frame, ProjectionJobCount);
+
+  RunSoftwareRendererJobs(Renderer, RasterizeSoftwareTile, &Frame, TileCount);
+}
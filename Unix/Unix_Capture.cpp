@@ -0,0 +1,302 @@
+// Asynchronous capture of the OpenGL view to disk.
+// Every frame, glReadPixels targets one of a ring of pixel buffer objects, so the read completes on the GPU side without
+// stalling. The buffer is only mapped UNIX_CAPTURE_PIXEL_BUFFER_COUNT frames later, once its transfer is long done, and
+// its pixels get copied into a queue consumed by a writer thread which converts and writes them (Unix_FrameWriter.cpp).
+// When the writer falls behind and the queue is full, frames get dropped rather than slowing down the main loop.
+//
+// The main loop isn't locked to the stream's frame rate, so every frame carries the time it got read. The writer places it
+// at the stream frame due at that time: frames read faster than the rate get skipped, and gaps left by a slower loop or
+// dropped frames get filled by repeating the last frame written, so the stream plays back in real time.
+// The capture size is fixed for the whole stream. When the window is smaller, the missing area is written black.
+// When writing fails (e.g. full disk), the writer discards every frame left and the main loop stops the capture.
+
+#define UNIX_CAPTURE_PIXEL_BUFFER_COUNT 3
+#define UNIX_CAPTURE_QUEUE_LENGTH 8
+
+struct Unix_Capture_State_Data
+{
+  bool IsActive = false;
+  int Width = 0;
+  int Height = 0;
+  int FrameRate = 0;
+
+  // Part of the frame covered by the window, at most Width x Height.
+  int ViewportWidth = 0;
+  int ViewportHeight = 0;
+
+  GLuint PixelBuffers[UNIX_CAPTURE_PIXEL_BUFFER_COUNT];
+  double ReadTimes[UNIX_CAPTURE_PIXEL_BUFFER_COUNT];
+  int ReadWidths[UNIX_CAPTURE_PIXEL_BUFFER_COUNT];
+  int ReadHeights[UNIX_CAPTURE_PIXEL_BUFFER_COUNT];
+  int IssuedFrameCount = 0; // Frames read into pixel buffers so far.
+
+  // Queue of frames waiting for the writer thread, RGBA bottom row first.
+  unsigned char* QueueSlots[UNIX_CAPTURE_QUEUE_LENGTH];
+  double QueueTimes[UNIX_CAPTURE_QUEUE_LENGTH];
+  int QueueHead = 0;
+  int QueuedFrameCount = 0;
+  int DroppedFrameCount = 0;
+  bool StopRequested = false;
+  bool HasWriteFailed = false;
+
+  // Owned by the writer thread.
+  bool HasFirstFrameTime = false;
+  double FirstFrameTime = 0;
+  int RepeatedFrameCount = 0;
+  int SkippedFrameCount = 0;
+
+  pthread_t WriterThread;
+  pthread_mutex_t Mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t FrameQueued = PTHREAD_COND_INITIALIZER;
+  pthread_cond_t FrameWritten = PTHREAD_COND_INITIALIZER;
+
+  Unix_Frame_Writer Writer;
+};
+
+Unix_Capture_State_Data UnixCaptureState;
+
+void* Unix_CaptureWriterMain(void*)
+{
+  Unix_Capture_State_Data& cs = UnixCaptureState;
+
+  pthread_mutex_lock(&cs.Mutex);
+  while(true)
+    {
+      while (cs.QueuedFrameCount == 0 && !cs.StopRequested)
+	{
+	  pthread_cond_wait(&cs.FrameQueued, &cs.Mutex);
+	}
+
+      if (cs.QueuedFrameCount == 0)
+	{
+	  break;
+	}
+
+      // The slot stays owned by the writer until the queue count gets decremented.
+      unsigned char* Frame = cs.QueueSlots[cs.QueueHead];
+      double FrameTime = cs.QueueTimes[cs.QueueHead];
+      bool HasWriteFailed = cs.HasWriteFailed;
+      pthread_mutex_unlock(&cs.Mutex);
+
+      if (!cs.HasFirstFrameTime)
+	{
+	  cs.FirstFrameTime = FrameTime;
+	  cs.HasFirstFrameTime = true;
+	}
+
+      // Frames still queued after a failure get discarded.
+      bool Succeeded = true;
+      if (!HasWriteFailed)
+	{
+	  int DueFrameIndex = static_cast<int>((FrameTime - cs.FirstFrameTime) * cs.FrameRate + 0.5);
+	  while (Succeeded && cs.Writer.FrameIndex < DueFrameIndex)
+	    {
+	      Succeeded = Unix_RepeatFrame(cs.Writer);
+	      cs.RepeatedFrameCount += Succeeded;
+	    }
+
+	  if (Succeeded && cs.Writer.FrameIndex == DueFrameIndex)
+	    {
+	      Succeeded = Unix_WriteFrame(cs.Writer, Frame, 4, true);
+	    }
+	  else if (Succeeded)
+	    {
+	      cs.SkippedFrameCount++;
+	    }
+
+	  if (!Succeeded)
+	    {
+	      printf("ERROR - Couldn't write to capture '%s', stopping capture !\n", cs.Writer.Path);
+	    }
+	}
+
+      pthread_mutex_lock(&cs.Mutex);
+      cs.HasWriteFailed = cs.HasWriteFailed || !Succeeded;
+      cs.QueueHead = (cs.QueueHead + 1) % UNIX_CAPTURE_QUEUE_LENGTH;
+      cs.QueuedFrameCount--;
+      pthread_cond_signal(&cs.FrameWritten);
+    }
+  pthread_mutex_unlock(&cs.Mutex);
+
+  return nullptr;
+}
+
+bool Unix_StartCapture(const char* Path, int Width, int Height, int FrameRate)
+{
+  Unix_Capture_State_Data& cs = UnixCaptureState;
+
+  if (!Unix_OpenFrameWriter(cs.Writer, Path, Unix_GuessFrameFormat(Path), Width, Height, FrameRate))
+    {
+      return false;
+    }
+
+  cs.Width = Width;
+  cs.Height = Height;
+  cs.FrameRate = FrameRate;
+  cs.ViewportWidth = Width;
+  cs.ViewportHeight = Height;
+  size_t FrameSize = static_cast<size_t>(Width) * Height * 4;
+
+  glGenBuffers(UNIX_CAPTURE_PIXEL_BUFFER_COUNT, cs.PixelBuffers);
+  for (int BufferIndex = 0; BufferIndex < UNIX_CAPTURE_PIXEL_BUFFER_COUNT; BufferIndex++)
+    {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, cs.PixelBuffers[BufferIndex]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, FrameSize, NULL, GL_STREAM_READ);
+    }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  for (int SlotIndex = 0; SlotIndex < UNIX_CAPTURE_QUEUE_LENGTH; SlotIndex++)
+    {
+      cs.QueueSlots[SlotIndex] = static_cast<unsigned char*>(malloc(FrameSize));
+    }
+
+  if (pthread_create(&cs.WriterThread, NULL, Unix_CaptureWriterMain, NULL) != 0)
+    {
+      printf("ERROR - Couldn't create capture writer thread !\n");
+      return false;
+    }
+
+  cs.IsActive = true;
+  printf("Capturing %dx%d frames at %d per second to '%s'.\n", Width, Height, FrameRate, Path);
+  return true;
+}
+
+// Call whenever the window gets resized. Only the part of the frame still covered by the window gets read.
+void Unix_SetCaptureViewport(int Width, int Height)
+{
+  Unix_Capture_State_Data& cs = UnixCaptureState;
+  cs.ViewportWidth = Width < cs.Width ? Width : cs.Width;
+  cs.ViewportHeight = Height < cs.Height ? Height : cs.Height;
+}
+
+// Maps the pixel buffer holding the given issued frame and queues its content for the writer thread.
+// When the queue is full, the frame gets dropped if CanDrop or waits for the writer otherwise.
+void Unix_CollectCapturedFrame(int FrameIndex, bool CanDrop)
+{
+  Unix_Capture_State_Data& cs = UnixCaptureState;
+
+  int BufferIndex = FrameIndex % UNIX_CAPTURE_PIXEL_BUFFER_COUNT;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, cs.PixelBuffers[BufferIndex]);
+  const unsigned char* Pixels = static_cast<const unsigned char*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+
+  if (Pixels != nullptr)
+    {
+      pthread_mutex_lock(&cs.Mutex);
+      while (!CanDrop && cs.QueuedFrameCount == UNIX_CAPTURE_QUEUE_LENGTH)
+	{
+	  pthread_cond_wait(&cs.FrameWritten, &cs.Mutex);
+	}
+      bool HasFreeSlot = cs.QueuedFrameCount < UNIX_CAPTURE_QUEUE_LENGTH;
+      int SlotIndex = (cs.QueueHead + cs.QueuedFrameCount) % UNIX_CAPTURE_QUEUE_LENGTH;
+      pthread_mutex_unlock(&cs.Mutex);
+
+      if (HasFreeSlot)
+	{
+	  // Only this thread adds to the queue: the slot stays free while copying outside of the lock.
+	  unsigned char* Slot = cs.QueueSlots[SlotIndex];
+	  size_t RowSize = static_cast<size_t>(cs.Width) * 4;
+	  int ReadWidth = cs.ReadWidths[BufferIndex];
+	  int ReadHeight = cs.ReadHeights[BufferIndex];
+	  if (ReadWidth == cs.Width && ReadHeight == cs.Height)
+	    {
+	      memcpy(Slot, Pixels, RowSize * cs.Height);
+	    }
+	  else
+	    {
+	      // Rows were read with the frame's stride, from the bottom left corner.
+	      memset(Slot, 0, RowSize * cs.Height);
+	      for (int Row = 0; Row < ReadHeight; Row++)
+		{
+		  memcpy(Slot + Row * RowSize, Pixels + Row * RowSize, static_cast<size_t>(ReadWidth) * 4);
+		}
+	    }
+
+	  pthread_mutex_lock(&cs.Mutex);
+	  cs.QueueTimes[SlotIndex] = cs.ReadTimes[BufferIndex];
+	  cs.QueuedFrameCount++;
+	  pthread_cond_signal(&cs.FrameQueued);
+	  pthread_mutex_unlock(&cs.Mutex);
+	}
+      else
+	{
+	  cs.DroppedFrameCount++;
+	}
+
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Collects frames still in flight, waits for the writer thread to write everything and releases capture resources.
+void Unix_StopCapture()
+{
+  Unix_Capture_State_Data& cs = UnixCaptureState;
+  if (!cs.IsActive)
+    {
+      return;
+    }
+
+  int FirstPendingFrame = cs.IssuedFrameCount > UNIX_CAPTURE_PIXEL_BUFFER_COUNT ? cs.IssuedFrameCount - UNIX_CAPTURE_PIXEL_BUFFER_COUNT : 0;
+  for (int FrameIndex = FirstPendingFrame; FrameIndex < cs.IssuedFrameCount; FrameIndex++)
+    {
+      Unix_CollectCapturedFrame(FrameIndex, false);
+    }
+
+  pthread_mutex_lock(&cs.Mutex);
+  cs.StopRequested = true;
+  pthread_cond_signal(&cs.FrameQueued);
+  pthread_mutex_unlock(&cs.Mutex);
+  pthread_join(cs.WriterThread, NULL);
+
+  printf("Capture %s: %d frames written at %d per second, %d of them repeated to fill gaps, %d skipped ahead of the rate, %d dropped.\n",
+	 cs.HasWriteFailed ? "stopped by a write error" : "done", cs.Writer.FrameIndex, cs.FrameRate,
+	 cs.RepeatedFrameCount, cs.SkippedFrameCount, cs.DroppedFrameCount);
+
+  Unix_CloseFrameWriter(cs.Writer);
+  glDeleteBuffers(UNIX_CAPTURE_PIXEL_BUFFER_COUNT, cs.PixelBuffers);
+  for (int SlotIndex = 0; SlotIndex < UNIX_CAPTURE_QUEUE_LENGTH; SlotIndex++)
+    {
+      free(cs.QueueSlots[SlotIndex]);
+    }
+
+  cs.IsActive = false;
+}
+
+// Call once per frame after drawing, before swapping buffers.
+void Unix_CaptureFrame()
+{
+  Unix_Capture_State_Data& cs = UnixCaptureState;
+  if (!cs.IsActive)
+    {
+      return;
+    }
+
+  pthread_mutex_lock(&cs.Mutex);
+  bool HasWriteFailed = cs.HasWriteFailed;
+  pthread_mutex_unlock(&cs.Mutex);
+  if (HasWriteFailed)
+    {
+      Unix_StopCapture();
+      return;
+    }
+
+  // The buffer about to be reused holds the frame issued UNIX_CAPTURE_PIXEL_BUFFER_COUNT frames ago.
+  if (cs.IssuedFrameCount >= UNIX_CAPTURE_PIXEL_BUFFER_COUNT)
+    {
+      Unix_CollectCapturedFrame(cs.IssuedFrameCount - UNIX_CAPTURE_PIXEL_BUFFER_COUNT, true);
+    }
+
+  int BufferIndex = cs.IssuedFrameCount % UNIX_CAPTURE_PIXEL_BUFFER_COUNT;
+  cs.ReadTimes[BufferIndex] = GetWallClockSeconds();
+  cs.ReadWidths[BufferIndex] = cs.ViewportWidth;
+  cs.ReadHeights[BufferIndex] = cs.ViewportHeight;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, cs.PixelBuffers[BufferIndex]);
+  glPixelStorei(GL_PACK_ROW_LENGTH, cs.Width);
+  glReadPixels(0, 0, cs.ViewportWidth, cs.ViewportHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  cs.IssuedFrameCount++;
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Reads a Simulation configuration file into Config. Returns false if the file couldn't be read.
+// The whole file gets read, whatever its size.
+bool ReadConfigFile(const char* FileName, SimulationConfig& Config)
+{
+  FILE* ConfigFile = fopen(FileName, "r");
+  if (ConfigFile == nullptr)
+    {
+      printf("ERROR - Couldn't read configuration file '%s' !\n", FileName);
+      return false;
+    }
+
+  fseek(ConfigFile, 0, SEEK_END);
+  long FileSize = ftell(ConfigFile);
+  fseek(ConfigFile, 0, SEEK_SET);
+
+  char* Text = FileSize >= 0 ? static_cast<char*>(malloc(FileSize + 1)) : nullptr;
+  if (Text == nullptr)
+    {
+      printf("ERROR - Couldn't read configuration file '%s' !\n", FileName);
+      fclose(ConfigFile);
+      return false;
+    }
+
+  size_t ReadBytes = fread(Text, 1, FileSize, ConfigFile);
+  Text[ReadBytes] = '\0';
+  fclose(ConfigFile);
+
+  ParseSimulationConfig(Text, Config);
+  free(Text);
+  return true;
+}
@@ -0,0 +1,288 @@
+// Headless ensemble runner: runs many independent Simulations in a single process, without any display.
+// Each run of the parameter sweep is a job executed to completion by one worker of the job pool: runs share no data, so
+// throughput scales with the number of cores and small runs stay within a single worker's working set.
+//
+// Usage: ParticlesEnsemble <SweepFile> <OutputDirectory> [WorkerCount]
+// Build: g++ -O2 Unix/Unix_Ensemble.cpp -o ParticlesEnsemble -lpthread
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <time.h>
+
+#include "../ParticleSimulation.cpp"
+#include "Unix_Jobs.cpp"
+#include "Unix_Time.cpp"
+#include "Unix_Config.cpp"
+
+#define ENSEMBLE_RUN_NAME_LENGTH 64
+#define ENSEMBLE_PATH_LENGTH 256
+
+// One line of the sweep file.
+struct EnsembleRunParameters
+{
+  char Name[ENSEMBLE_RUN_NAME_LENGTH];
+  char ConfigFile[ENSEMBLE_PATH_LENGTH] = {0}; // Optional Simulation configuration Seed and CentralMass get applied on top of.
+  unsigned long long Seed = 1;
+  float CentralMass = 500;
+  int TickCount = 1000;
+  float TimeDelta = 0.01f;
+  int CheckpointInterval = 0; // Ticks between two checkpoints. 0 disables checkpoints.
+};
+
+struct EnsembleRunResult
+{
+  SimulationStatistics InitialStats;
+  SimulationStatistics FinalStats;
+  double WallClockSeconds = 0;
+  int CheckpointsWritten = 0;
+  bool Succeeded = false;
+};
+
+struct EnsembleData
+{
+  EnsembleRunParameters* Runs = nullptr;
+  EnsembleRunResult* Results = nullptr;
+  int RunCount = 0;
+  const char* OutputDirectory = nullptr;
+  int CompletedRunCount = 0;
+};
+
+// Parses the sweep file. Each non empty line not starting with '#' describes one run:
+// Name Seed CentralMass TickCount TimeDelta CheckpointInterval [ConfigFile]
+// Returns number of runs read, or -1 if the file couldn't be read. Runs is allocated and must be freed by the caller.
+int ReadSweepFile(const char* FileName, EnsembleRunParameters*& Runs)
+{
+  FILE* SweepFile = fopen(FileName, "r");
+  if (SweepFile == nullptr)
+    {
+      printf("ERROR - Couldn't read sweep file '%s' !\n", FileName);
+      return -1;
+    }
+
+  int RunCapacity = 64;
+  int RunCount = 0;
+  Runs = static_cast<EnsembleRunParameters*>(malloc(RunCapacity * sizeof(EnsembleRunParameters)));
+
+  char Line[512];
+  int LineNumber = 0;
+  while (fgets(Line, sizeof(Line), SweepFile))
+    {
+      LineNumber++;
+
+      char* LineStart = Line;
+      while (*LineStart == ' ' || *LineStart == '\t')
+	{
+	  LineStart++;
+	}
+      if (*LineStart == '#' || *LineStart == '\n' || *LineStart == '\0')
+	{
+	  continue;
+	}
+
+      EnsembleRunParameters Run;
+      int ReadFields = sscanf(LineStart, "%63s %llu %f %d %f %d %255s", Run.Name, &Run.Seed, &Run.CentralMass,
+			      &Run.TickCount, &Run.TimeDelta, &Run.CheckpointInterval, Run.ConfigFile);
+      if (ReadFields < 2)
+	{
+	  printf("WARNING - Ignoring malformed line %d of sweep file '%s'.\n", LineNumber, FileName);
+	  continue;
+	}
+
+      if (RunCount == RunCapacity)
+	{
+	  RunCapacity *= 2;
+	  Runs = static_cast<EnsembleRunParameters*>(realloc(Runs, RunCapacity * sizeof(EnsembleRunParameters)));
+	}
+      Runs[RunCount++] = Run;
+    }
+
+  fclose(SweepFile);
+  return RunCount;
+}
+
+// Checkpoint layout: "PCKP" magic, format version, tick count, particle count, then for each particle
+// position xyz, velocity xyz, mass, radius, color rgb (floats) and active flag (int).
+// Particles are written in ID order, so checkpoints compare equal whatever the memory order of Particles.
+bool WriteCheckpoint(const char* FileName, const SimulationContext& Context)
+{
+  FILE* CheckpointFile = fopen(FileName, "wb");
+  if (CheckpointFile == nullptr)
+    {
+      printf("ERROR - Couldn't write checkpoint '%s' !\n", FileName);
+      return false;
+    }
+
+  int Header[4] = { 0x504B4350, 1, Context.TickCount, Context.ParticleCount };
+  fwrite(Header, sizeof(Header), 1, CheckpointFile);
+
+  for (int ParticleID = 0; ParticleID < Context.ParticleCount; ParticleID++)
+    {
+      const Particle& Part = Context.Particles[Context.ParticleIndexByID[ParticleID]];
+      float Values[11] =
+	{
+	  Part.WorldPosition.x, Part.WorldPosition.y, Part.WorldPosition.z,
+	  Part.Velocity.x, Part.Velocity.y, Part.Velocity.z,
+	  Part.Mass, Part.Radius,
+	  Part.Color.r, Part.Color.g, Part.Color.b
+	};
+      int IsActive = Part.IsActive;
+      fwrite(Values, sizeof(Values), 1, CheckpointFile);
+      fwrite(&IsActive, sizeof(IsActive), 1, CheckpointFile);
+    }
+
+  bool Succeeded = ferror(CheckpointFile) == 0;
+  fclose(CheckpointFile);
+  return Succeeded;
+}
+
+void RunEnsembleJob(void* JobData, int JobIndex)
+{
+  EnsembleData& Ensemble = *static_cast<EnsembleData*>(JobData);
+  const EnsembleRunParameters& Run = Ensemble.Runs[JobIndex];
+  EnsembleRunResult& Result = Ensemble.Results[JobIndex];
+
+  double StartTime = GetWallClockSeconds();
+
+  // Context lives on the worker's stack and its Particles get allocated by this worker: no other thread ever touches them.
+  // Context.RunParallelJobs stays null, each run being a job of the pool already.
+  SimulationContext Context;
+  if (Run.ConfigFile[0] != '\0' && !ReadConfigFile(Run.ConfigFile, Context.Config))
+    {
+      Result.Succeeded = false;
+      return;
+    }
+  Context.Config.Seed = Run.Seed;
+  Context.Config.CentralMass = Run.CentralMass;
+  if (!InitializeSimulation(Context))
+    {
+      Result.Succeeded = false;
+      return;
+    }
+
+  Result.InitialStats = ComputeSimulationStatistics(Context);
+  Result.Succeeded = true;
+
+  char CheckpointFileName[512];
+  for (int Tick = 0; Tick < Run.TickCount; Tick++)
+    {
+      StepSimulation(Context, Run.TimeDelta);
+
+      if (Run.CheckpointInterval > 0 && (Tick + 1) % Run.CheckpointInterval == 0)
+	{
+	  snprintf(CheckpointFileName, sizeof(CheckpointFileName), "%s/%s_%08d.ckpt", Ensemble.OutputDirectory, Run.Name, Context.TickCount);
+	  if (WriteCheckpoint(CheckpointFileName, Context))
+	    {
+	      Result.CheckpointsWritten++;
+	    }
+	  else
+	    {
+	      Result.Succeeded = false;
+	    }
+	}
+    }
+
+  Result.FinalStats = ComputeSimulationStatistics(Context);
+  Result.WallClockSeconds = GetWallClockSeconds() - StartTime;
+
+  ShutdownSimulation(Context);
+
+  int Completed = __atomic_add_fetch(&Ensemble.CompletedRunCount, 1, __ATOMIC_RELAXED);
+  printf("[%d/%d] Run '%s' done in %.3fs.\n", Completed, Ensemble.RunCount, Run.Name, Result.WallClockSeconds);
+}
+
+// Writes one CSV line of summary statistics per run.
+bool WriteEnsembleSummary(const char* FileName, const EnsembleData& Ensemble)
+{
+  FILE* SummaryFile = fopen(FileName, "w");
+  if (SummaryFile == nullptr)
+    {
+      printf("ERROR - Couldn't write summary file '%s' !\n", FileName);
+      return false;
+    }
+
+  fprintf(SummaryFile, "name,seed,central_mass,ticks,time_delta,wall_seconds,active_particles,"
+	  "initial_energy,final_energy,relative_energy_drift,initial_momentum,final_momentum,"
+	  "final_center_of_mass_x,final_center_of_mass_y,final_center_of_mass_z,checkpoints,succeeded\n");
+
+  for (int RunIndex = 0; RunIndex < Ensemble.RunCount; RunIndex++)
+    {
+      const EnsembleRunParameters& Run = Ensemble.Runs[RunIndex];
+      const EnsembleRunResult& Result = Ensemble.Results[RunIndex];
+
+      double InitialEnergy = Result.InitialStats.TotalEnergy;
+      double FinalEnergy = Result.FinalStats.TotalEnergy;
+      double EnergyDrift = InitialEnergy != 0 ? (FinalEnergy - InitialEnergy) / fabs(InitialEnergy) : 0;
+
+      fprintf(SummaryFile, "%s,%llu,%g,%d,%g,%.6f,%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%d,%d\n",
+	      Run.Name, Run.Seed, Run.CentralMass, Run.TickCount, Run.TimeDelta, Result.WallClockSeconds,
+	      Result.FinalStats.ActiveParticleCount, InitialEnergy, FinalEnergy, EnergyDrift,
+	      sqrt(LengthSquared(Result.InitialStats.Momentum)), sqrt(LengthSquared(Result.FinalStats.Momentum)),
+	      Result.FinalStats.CenterOfMass.x, Result.FinalStats.CenterOfMass.y, Result.FinalStats.CenterOfMass.z,
+	      Result.CheckpointsWritten, Result.Succeeded);
+    }
+
+  bool Succeeded = ferror(SummaryFile) == 0;
+  fclose(SummaryFile);
+  return Succeeded;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+    {
+      printf("Usage: %s <SweepFile> <OutputDirectory> [WorkerCount]\n", argv[0]);
+      return 1;
+    }
+
+  EnsembleData Ensemble;
+  Ensemble.OutputDirectory = argv[2];
+  Ensemble.RunCount = ReadSweepFile(argv[1], Ensemble.Runs);
+  if (Ensemble.RunCount < 0)
+    {
+      return 1;
+    }
+
+  // Every checkpoint and the summary go there: fail now rather than after running everything.
+  struct stat OutputDirectoryStat;
+  if (mkdir(Ensemble.OutputDirectory, 0755) != 0
+      && (errno != EEXIST || stat(Ensemble.OutputDirectory, &OutputDirectoryStat) != 0 || !S_ISDIR(OutputDirectoryStat.st_mode)))
+    {
+      printf("ERROR - Couldn't create output directory '%s': %s\n", Ensemble.OutputDirectory,
+	     errno == EEXIST ? "not a directory" : strerror(errno));
+      return 1;
+    }
+
+  int WorkerCount = argc > 3 ? atoi(argv[3]) : 0;
+  if (!Unix_InitializeJobPool(WorkerCount))
+    {
+      return 1;
+    }
+
+  printf("Running %d simulations on %d workers.\n", Ensemble.RunCount, UnixJobPool.WorkerCount);
+
+  Ensemble.Results = new EnsembleRunResult[Ensemble.RunCount];
+
+  double StartTime = GetWallClockSeconds();
+  Unix_RunParallelJobs(RunEnsembleJob, &Ensemble, Ensemble.RunCount);
+  double TotalSeconds = GetWallClockSeconds() - StartTime;
+
+  Unix_ShutdownJobPool();
+
+  char SummaryFileName[512];
+  snprintf(SummaryFileName, sizeof(SummaryFileName), "%s/summary.csv", Ensemble.OutputDirectory);
+  bool Succeeded = WriteEnsembleSummary(SummaryFileName, Ensemble);
+
+  printf("Ensemble done in %.3fs (%.2f runs/s). Summary written to '%s'.\n", TotalSeconds,
+	 TotalSeconds > 0 ? Ensemble.RunCount / TotalSeconds : 0, SummaryFileName);
+
+  delete[] Ensemble.Results;
+  free(Ensemble.Runs);
+  return Succeeded ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// Force accumulation benchmark: times Simulation ticks with the default force kernel and the reproducible one
+// (SimulationConfig::ReproducibleForces) on the same initial conditions, then checks which of them produce the same
+// trajectories bit for bit when run serially in creation order and across workers with periodic reordering.
+//
+// Usage: ParticlesForceBenchmark <ConfigFile|-> [TickCount] [WorkerCount]
+// Build: g++ -O2 -ffp-contract=off Unix/Unix_ForceBenchmark.cpp -o ParticlesForceBenchmark -lpthread
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <time.h>
+
+#include "../ParticleSimulation.cpp"
+#include "Unix_Jobs.cpp"
+#include "Unix_Time.cpp"
+#include "Unix_Config.cpp"
+
+#define BENCHMARK_TIME_DELTA 0.01f
+
+// Timings alternate between kernels this many times, keeping the best of each, to filter out noise from other processes.
+#define BENCHMARK_REPETITION_COUNT 3
+
+// Reorder interval of the parallel run of the reproducibility check. Odd, so that it keeps shuffling sources' order.
+#define BENCHMARK_REORDER_INTERVAL 7
+
+// Initializes a Simulation from Config and runs TickCount ticks. Returns average seconds per tick, initialization excluded.
+double RunBenchmarkSimulation(SimulationContext& Context, const SimulationConfig& Config, int TickCount, bool IsParallel)
+{
+  Context.Config = Config;
+  Context.RunParallelJobs = IsParallel ? Unix_RunParallelJobs : nullptr;
+  if (!InitializeSimulation(Context))
+    {
+      // Nothing to measure without Particles.
+      exit(1);
+    }
+
+  double StartTime = GetWallClockSeconds();
+  for (int TickIndex = 0; TickIndex < TickCount; TickIndex++)
+    {
+      StepSimulation(Context, BENCHMARK_TIME_DELTA);
+    }
+
+  return (GetWallClockSeconds() - StartTime) / TickCount;
+}
+
+// FNV-1a hash of every Particle's position and velocity, in ID order so that memory order doesn't matter.
+unsigned long long HashTrajectories(const SimulationContext& Context)
+{
+  unsigned long long Hash = 0xCBF29CE484222325ULL;
+  for (int ParticleID = 0; ParticleID < Context.ParticleCount; ParticleID++)
+    {
+      const Particle& Part = Context.Particles[Context.ParticleIndexByID[ParticleID]];
+      float State[6] = { Part.WorldPosition.x, Part.WorldPosition.y, Part.WorldPosition.z,
+			 Part.Velocity.x, Part.Velocity.y, Part.Velocity.z };
+
+      const unsigned char* Bytes = reinterpret_cast<const unsigned char*>(State);
+      for (unsigned int ByteIndex = 0; ByteIndex < sizeof(State); ByteIndex++)
+	{
+	  Hash = (Hash ^ Bytes[ByteIndex]) * 0x100000001B3ULL;
+	}
+    }
+
+  return Hash;
+}
+
+// Runs Config serially without reordering, then in parallel with reordering. Returns true if both end up identical.
+bool CheckReproducibility(const SimulationConfig& Config, int TickCount)
+{
+  SimulationContext Context;
+
+  SimulationConfig SerialConfig = Config;
+  SerialConfig.ReorderInterval = 0;
+  RunBenchmarkSimulation(Context, SerialConfig, TickCount, false);
+  unsigned long long SerialHash = HashTrajectories(Context);
+
+  SimulationConfig ParallelConfig = Config;
+  ParallelConfig.ReorderInterval = BENCHMARK_REORDER_INTERVAL;
+  RunBenchmarkSimulation(Context, ParallelConfig, TickCount, true);
+  unsigned long long ParallelHash = HashTrajectories(Context);
+
+  ShutdownSimulation(Context);
+  return SerialHash == ParallelHash;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+    {
+      printf("Usage: %s <ConfigFile|-> [TickCount] [WorkerCount]\n", argv[0]);
+      return 1;
+    }
+
+  SimulationConfig Config;
+  if (strcmp(argv[1], "-") != 0 && !ReadConfigFile(argv[1], Config))
+    {
+      return 1;
+    }
+
+  int TickCount = argc > 2 ? atoi(argv[2]) : 100;
+  int WorkerCount = argc > 3 ? atoi(argv[3]) : 0;
+  if (TickCount <= 0)
+    {
+      printf("ERROR - Invalid tick count.\n");
+      return 1;
+    }
+
+  if (!Unix_InitializeJobPool(WorkerCount))
+    {
+      return 1;
+    }
+
+  SimulationConfig DefaultConfig = Config;
+  DefaultConfig.ReproducibleForces = false;
+  SimulationConfig ReproducibleConfig = Config;
+  ReproducibleConfig.ReproducibleForces = true;
+
+  SimulationContext Context;
+
+  // One warm up tick first, so that neither kernel pays for page faults of the freshly allocated buffers.
+  RunBenchmarkSimulation(Context, DefaultConfig, 1, true);
+
+  double DefaultSeconds = 0, ReproducibleSeconds = 0;
+  int FixedPointShift = SIMULATION_FIXED_POINT_SHIFT;
+  for (int Repetition = 0; Repetition < BENCHMARK_REPETITION_COUNT; Repetition++)
+    {
+      double Seconds = RunBenchmarkSimulation(Context, DefaultConfig, TickCount, true);
+      DefaultSeconds = Repetition == 0 || Seconds < DefaultSeconds ? Seconds : DefaultSeconds;
+
+      Seconds = RunBenchmarkSimulation(Context, ReproducibleConfig, TickCount, true);
+      ReproducibleSeconds = Repetition == 0 || Seconds < ReproducibleSeconds ? Seconds : ReproducibleSeconds;
+      FixedPointShift = Context.FixedPointShift;
+    }
+  double DefaultInteractions = static_cast<double>(Context.PairInteractionCount);
+
+  printf("Scenario %s, %d particles (%d sources), best of %d runs of %d ticks on %d workers.\n", ScenarioTypeNames[static_cast<int>(Config.Scenario)],
+	 Context.ParticleCount, Context.SourceParticleCount, BENCHMARK_REPETITION_COUNT, TickCount, UnixJobPool.WorkerCount);
+  printf("Default kernel:      %9.3fms per tick, %8.1fM interactions/s\n",
+	 DefaultSeconds * 1000, DefaultInteractions / DefaultSeconds / 1e6);
+  printf("Reproducible kernel: %9.3fms per tick, %8.1fM interactions/s (%+.1f%% time per tick), fixed point precision 2^-%d\n",
+	 ReproducibleSeconds * 1000, DefaultInteractions / ReproducibleSeconds / 1e6, (ReproducibleSeconds / DefaultSeconds - 1) * 100,
+	 FixedPointShift);
+
+  ShutdownSimulation(Context);
+
+  printf("Trajectories after %d ticks, serial in creation order vs. %d workers reordering every %d ticks:\n",
+	 TickCount, UnixJobPool.WorkerCount, BENCHMARK_REORDER_INTERVAL);
+  printf("Default kernel:      %s\n", CheckReproducibility(DefaultConfig, TickCount) ? "bit-identical" : "differ");
+  printf("Reproducible kernel: %s\n", CheckReproducibility(ReproducibleConfig, TickCount) ? "bit-identical" : "differ");
+
+  Unix_ShutdownJobPool();
+
+  return 0;
+}
@@ -0,0 +1,205 @@
+// Writes rendered frames to disk, either as a numbered sequence of binary PPM images or as a single raw YUV4MPEG2 stream.
+
+enum class Unix_Frame_Format
+  {
+    PPM_SEQUENCE, // Path is a printf pattern receiving the frame index, e.g. "frames/frame_%05d.ppm".
+    Y4M           // Path is the stream's file. 4:2:0 chroma subsampling, full range BT.601 (C420jpeg).
+  };
+
+struct Unix_Frame_Writer
+{
+  Unix_Frame_Format Format = Unix_Frame_Format::PPM_SEQUENCE;
+  char Path[512] = {0};
+  int Width = 0;
+  int Height = 0;
+  int FrameIndex = 0;
+
+  FILE* Stream = nullptr;
+  unsigned char* ConversionBuffer = nullptr; // Packed RGB rows (PPM) or Y, U and V planes (Y4M).
+  bool HasHeldFrame = false; // ConversionBuffer holds the last frame written, see Unix_RepeatFrame.
+};
+
+// Picks Y4M for paths ending in ".y4m", PPM sequence otherwise.
+Unix_Frame_Format Unix_GuessFrameFormat(const char* Path)
+{
+  size_t PathLength = strlen(Path);
+  if (PathLength >= 4 && strcmp(Path + PathLength - 4, ".y4m") == 0)
+    {
+      return Unix_Frame_Format::Y4M;
+    }
+
+  return Unix_Frame_Format::PPM_SEQUENCE;
+}
+
+bool Unix_OpenFrameWriter(Unix_Frame_Writer& Writer, const char* Path, Unix_Frame_Format Format, int Width, int Height, int FrameRate)
+{
+  Writer.Format = Format;
+  Writer.Width = Width;
+  Writer.Height = Height;
+  Writer.FrameIndex = 0;
+  Writer.HasHeldFrame = false;
+  snprintf(Writer.Path, sizeof(Writer.Path), "%s", Path);
+
+  if (Format == Unix_Frame_Format::Y4M)
+    {
+      Writer.Stream = fopen(Path, "wb");
+      if (Writer.Stream == nullptr)
+	{
+	  printf("ERROR - Couldn't open frame stream '%s' !\n", Path);
+	  return false;
+	}
+
+      fprintf(Writer.Stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", Width, Height, FrameRate);
+
+      int ChromaSize = ((Width + 1) / 2) * ((Height + 1) / 2);
+      Writer.ConversionBuffer = static_cast<unsigned char*>(malloc(static_cast<size_t>(Width) * Height + 2 * ChromaSize));
+    }
+  else
+    {
+      if (strchr(Path, '%') == nullptr)
+	{
+	  printf("ERROR - PPM sequence path '%s' needs a frame index pattern such as %%05d !\n", Path);
+	  return false;
+	}
+      Writer.ConversionBuffer = static_cast<unsigned char*>(malloc(static_cast<size_t>(Width) * Height * 3));
+    }
+
+  return Writer.ConversionBuffer != nullptr;
+}
+
+// Reads pixel (x, y) of a source image, y = 0 being the top row.
+static const unsigned char* Unix_SourcePixel(const unsigned char* Pixels, int Width, int Height, int BytesPerPixel, bool IsBottomUp, int x, int y)
+{
+  int SourceRow = IsBottomUp ? Height - 1 - y : y;
+  return Pixels + (static_cast<size_t>(SourceRow) * Width + x) * BytesPerPixel;
+}
+
+// Writes converted frame data: Y, U and V planes (Y4M) or packed RGB rows, top first (PPM).
+static bool Unix_OutputFrame(Unix_Frame_Writer& Writer, const unsigned char* FrameData)
+{
+  int Width = Writer.Width;
+  int Height = Writer.Height;
+  bool Succeeded = true;
+
+  if (Writer.Format == Unix_Frame_Format::Y4M)
+    {
+      size_t ChromaSize = static_cast<size_t>((Width + 1) / 2) * ((Height + 1) / 2);
+      fputs("FRAME\n", Writer.Stream);
+      fwrite(FrameData, 1, static_cast<size_t>(Width) * Height + 2 * ChromaSize, Writer.Stream);
+      Succeeded = ferror(Writer.Stream) == 0;
+    }
+  else
+    {
+      char FileName[600];
+      snprintf(FileName, sizeof(FileName), Writer.Path, Writer.FrameIndex);
+      FILE* FrameFile = fopen(FileName, "wb");
+      if (FrameFile == nullptr)
+	{
+	  printf("ERROR - Couldn't write frame '%s' !\n", FileName);
+	  return false;
+	}
+
+      fprintf(FrameFile, "P6\n%d %d\n255\n", Width, Height);
+      fwrite(FrameData, 1, static_cast<size_t>(Width) * Height * 3, FrameFile);
+      Succeeded = ferror(FrameFile) == 0;
+      fclose(FrameFile);
+    }
+
+  Writer.FrameIndex++;
+  return Succeeded;
+}
+
+// Writes one frame. Pixels are RGB (BytesPerPixel = 3) or RGBA (4), rows stored top first unless IsBottomUp,
+// as returned by glReadPixels.
+bool Unix_WriteFrame(Unix_Frame_Writer& Writer, const unsigned char* Pixels, int BytesPerPixel, bool IsBottomUp)
+{
+  int Width = Writer.Width;
+  int Height = Writer.Height;
+
+  if (Writer.Format == Unix_Frame_Format::Y4M)
+    {
+      int ChromaWidth = (Width + 1) / 2;
+      int ChromaHeight = (Height + 1) / 2;
+      unsigned char* PlaneY = Writer.ConversionBuffer;
+      unsigned char* PlaneU = PlaneY + static_cast<size_t>(Width) * Height;
+      unsigned char* PlaneV = PlaneU + ChromaWidth * ChromaHeight;
+
+      for (int y = 0; y < Height; y++)
+	{
+	  for (int x = 0; x < Width; x++)
+	    {
+	      const unsigned char* Pixel = Unix_SourcePixel(Pixels, Width, Height, BytesPerPixel, IsBottomUp, x, y);
+	      PlaneY[y * Width + x] = static_cast<unsigned char>((77 * Pixel[0] + 150 * Pixel[1] + 29 * Pixel[2] + 128) >> 8);
+	    }
+	}
+
+      // Chroma from the average of each 2x2 block.
+      for (int ChromaY = 0; ChromaY < ChromaHeight; ChromaY++)
+	{
+	  for (int ChromaX = 0; ChromaX < ChromaWidth; ChromaX++)
+	    {
+	      int SumR = 0, SumG = 0, SumB = 0, SampleCount = 0;
+	      for (int y = ChromaY * 2; y < ChromaY * 2 + 2 && y < Height; y++)
+		{
+		  for (int x = ChromaX * 2; x < ChromaX * 2 + 2 && x < Width; x++)
+		    {
+		      const unsigned char* Pixel = Unix_SourcePixel(Pixels, Width, Height, BytesPerPixel, IsBottomUp, x, y);
+		      SumR += Pixel[0];
+		      SumG += Pixel[1];
+		      SumB += Pixel[2];
+		      SampleCount++;
+		    }
+		}
+
+	      int R = SumR / SampleCount, G = SumG / SampleCount, B = SumB / SampleCount;
+	      PlaneU[ChromaY * ChromaWidth + ChromaX] = static_cast<unsigned char>(((-43 * R - 85 * G + 128 * B + 128) >> 8) + 128);
+	      PlaneV[ChromaY * ChromaWidth + ChromaX] = static_cast<unsigned char>(((128 * R - 107 * G - 21 * B + 128) >> 8) + 128);
+	    }
+	}
+
+      Writer.HasHeldFrame = true;
+      return Unix_OutputFrame(Writer, Writer.ConversionBuffer);
+    }
+
+  // Packed top down RGB gets written as is, without holding a copy.
+  Writer.HasHeldFrame = BytesPerPixel != 3 || IsBottomUp;
+  if (!Writer.HasHeldFrame)
+    {
+      return Unix_OutputFrame(Writer, Pixels);
+    }
+
+  for (int y = 0; y < Height; y++)
+    {
+      for (int x = 0; x < Width; x++)
+	{
+	  const unsigned char* Pixel = Unix_SourcePixel(Pixels, Width, Height, BytesPerPixel, IsBottomUp, x, y);
+	  memcpy(Writer.ConversionBuffer + (static_cast<size_t>(y) * Width + x) * 3, Pixel, 3);
+	}
+    }
+
+  return Unix_OutputFrame(Writer, Writer.ConversionBuffer);
+}
+
+// Writes the last frame again, e.g. to fill a gap in a fixed rate stream. Returns false if there is no held frame to repeat,
+// which only happens before the first frame or after a PPM frame passed in packed top down RGB.
+bool Unix_RepeatFrame(Unix_Frame_Writer& Writer)
+{
+  if (!Writer.HasHeldFrame)
+    {
+      return false;
+    }
+
+  return Unix_OutputFrame(Writer, Writer.ConversionBuffer);
+}
+
+void Unix_CloseFrameWriter(Unix_Frame_Writer& Writer)
+{
+  if (Writer.Stream != nullptr)
+    {
+      fclose(Writer.Stream);
+    }
+  free(Writer.ConversionBuffer);
+
+  Writer.Stream = nullptr;
+  Writer.ConversionBuffer = nullptr;
+}
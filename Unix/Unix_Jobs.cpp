@@ -0,0 +1,203 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+
+// Worker thread pool backing SimulationContext::RunParallelJobs. Included after ParticleSimulation.cpp.
+
+#define UNIX_MAX_WORKER_COUNT 64
+
+// Persistent pool of worker threads. A batch of jobs is published to the pool and workers pull job indices
+// from a shared counter until the batch is exhausted, so uneven jobs get balanced across cores.
+struct Unix_Job_Pool_Data
+{
+  pthread_t Workers[UNIX_MAX_WORKER_COUNT];
+  int WorkerCount = 0;
+  int EnabledWorkerCount = 0; // Workers taking part in batches, the calling thread included. Others stay idle.
+
+  pthread_mutex_t Mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t BatchAvailable = PTHREAD_COND_INITIALIZER;
+  pthread_cond_t BatchDone = PTHREAD_COND_INITIALIZER;
+
+  // Current batch.
+  ParallelJobFunction Job = nullptr;
+  void* JobData = nullptr;
+  int JobCount = 0;
+  int NextJobIndex = 0;
+  int CompletedJobCount = 0;
+  unsigned int BatchGeneration = 0;
+
+  // Workers currently pulling job indices. A new batch can only reset NextJobIndex once this drops to 0.
+  int ActiveWorkerCount = 0;
+
+  bool ShuttingDown = false;
+};
+
+Unix_Job_Pool_Data UnixJobPool;
+
+// Runs jobs of the current batch until none are left. Returns number of jobs completed by the calling thread.
+int Unix_ConsumeJobs(ParallelJobFunction Job, void* JobData, int JobCount)
+{
+  int Completed = 0;
+  while(true)
+    {
+      int JobIndex = __atomic_fetch_add(&UnixJobPool.NextJobIndex, 1, __ATOMIC_RELAXED);
+      if (JobIndex >= JobCount)
+	{
+	  break;
+	}
+
+      Job(JobData, JobIndex);
+      Completed++;
+    }
+
+  return Completed;
+}
+
+void* Unix_JobWorkerMain(void* WorkerIndexPointer)
+{
+  int WorkerIndex = static_cast<int>(reinterpret_cast<intptr_t>(WorkerIndexPointer));
+  unsigned int SeenGeneration = 0;
+
+  pthread_mutex_lock(&UnixJobPool.Mutex);
+  while(true)
+    {
+      while (!UnixJobPool.ShuttingDown && UnixJobPool.BatchGeneration == SeenGeneration)
+	{
+	  pthread_cond_wait(&UnixJobPool.BatchAvailable, &UnixJobPool.Mutex);
+	}
+
+      if (UnixJobPool.ShuttingDown)
+	{
+	  break;
+	}
+
+      SeenGeneration = UnixJobPool.BatchGeneration;
+      if (WorkerIndex >= UnixJobPool.EnabledWorkerCount)
+	{
+	  continue;
+	}
+      
+      ParallelJobFunction Job = UnixJobPool.Job;
+      void* JobData = UnixJobPool.JobData;
+      int JobCount = UnixJobPool.JobCount;
+      UnixJobPool.ActiveWorkerCount++;
+      pthread_mutex_unlock(&UnixJobPool.Mutex);
+
+      int Completed = Unix_ConsumeJobs(Job, JobData, JobCount);
+
+      pthread_mutex_lock(&UnixJobPool.Mutex);
+      UnixJobPool.ActiveWorkerCount--;
+      UnixJobPool.CompletedJobCount += Completed;
+      pthread_cond_broadcast(&UnixJobPool.BatchDone);
+    }
+  pthread_mutex_unlock(&UnixJobPool.Mutex);
+
+  return nullptr;
+}
+
+// Starts worker threads. A WorkerCount of 0 or less uses one worker per online core.
+// The thread calling Unix_RunParallelJobs also executes jobs, so WorkerCount - 1 threads get created.
+bool Unix_InitializeJobPool(int WorkerCount)
+{
+  if (WorkerCount <= 0)
+    {
+      WorkerCount = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    }
+  if (WorkerCount < 1)
+    {
+      WorkerCount = 1;
+    }
+  if (WorkerCount > UNIX_MAX_WORKER_COUNT)
+    {
+      WorkerCount = UNIX_MAX_WORKER_COUNT;
+    }
+
+  UnixJobPool.WorkerCount = 1;
+  for (int WorkerIndex = 1; WorkerIndex < WorkerCount; WorkerIndex++)
+    {
+      if (pthread_create(&UnixJobPool.Workers[WorkerIndex], NULL, Unix_JobWorkerMain, reinterpret_cast<void*>(static_cast<intptr_t>(WorkerIndex))) != 0)
+	{
+	  printf("ERROR - Couldn't create job worker thread %d !\n", WorkerIndex);
+	  return false;
+	}
+      UnixJobPool.WorkerCount++;
+    }
+  UnixJobPool.EnabledWorkerCount = UnixJobPool.WorkerCount;
+
+  return true;
+}
+
+// Limits batches to the first WorkerCount workers, clamped to the pool's size. Must not be called while jobs are running.
+void Unix_SetEnabledWorkerCount(int WorkerCount)
+{
+  if (WorkerCount < 1)
+    {
+      WorkerCount = 1;
+    }
+  if (WorkerCount > UnixJobPool.WorkerCount)
+    {
+      WorkerCount = UnixJobPool.WorkerCount;
+    }
+
+  pthread_mutex_lock(&UnixJobPool.Mutex);
+  UnixJobPool.EnabledWorkerCount = WorkerCount;
+  pthread_mutex_unlock(&UnixJobPool.Mutex);
+}
+
+// Runs Job for every index in [0, JobCount) across the pool and returns once all of them completed.
+// Not reentrant: jobs must not call Unix_RunParallelJobs themselves.
+void Unix_RunParallelJobs(ParallelJobFunction Job, void* JobData, int JobCount)
+{
+  if (JobCount <= 0)
+    {
+      return;
+    }
+
+  if (UnixJobPool.EnabledWorkerCount <= 1 || JobCount == 1)
+    {
+      for (int JobIndex = 0; JobIndex < JobCount; JobIndex++)
+	{
+	  Job(JobData, JobIndex);
+	}
+      return;
+    }
+
+  pthread_mutex_lock(&UnixJobPool.Mutex);
+  while (UnixJobPool.ActiveWorkerCount > 0)
+    {
+      pthread_cond_wait(&UnixJobPool.BatchDone, &UnixJobPool.Mutex);
+    }
+  
+  UnixJobPool.Job = Job;
+  UnixJobPool.JobData = JobData;
+  UnixJobPool.JobCount = JobCount;
+  UnixJobPool.NextJobIndex = 0;
+  UnixJobPool.CompletedJobCount = 0;
+  UnixJobPool.BatchGeneration++;
+  pthread_cond_broadcast(&UnixJobPool.BatchAvailable);
+  pthread_mutex_unlock(&UnixJobPool.Mutex);
+
+  int Completed = Unix_ConsumeJobs(Job, JobData, JobCount);
+
+  pthread_mutex_lock(&UnixJobPool.Mutex);
+  UnixJobPool.CompletedJobCount += Completed;
+  while (UnixJobPool.CompletedJobCount < UnixJobPool.JobCount)
+    {
+      pthread_cond_wait(&UnixJobPool.BatchDone, &UnixJobPool.Mutex);
+    }
+  pthread_mutex_unlock(&UnixJobPool.Mutex);
+}
+
+void Unix_ShutdownJobPool()
+{
+  pthread_mutex_lock(&UnixJobPool.Mutex);
+  UnixJobPool.ShuttingDown = true;
+  pthread_cond_broadcast(&UnixJobPool.BatchAvailable);
+  pthread_mutex_unlock(&UnixJobPool.Mutex);
+
+  for (int WorkerIndex = 1; WorkerIndex < UnixJobPool.WorkerCount; WorkerIndex++)
+    {
+      pthread_join(UnixJobPool.Workers[WorkerIndex], NULL);
+    }
+  UnixJobPool.WorkerCount = 0;
+}
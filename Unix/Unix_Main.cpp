@@ -9,6 +9,13 @@
 
 #include "../GL/FunctionDefs.h"
 #include "../ParticleSimulation.cpp"
+#include "../Render/RenderCommands.h"
+#include "Unix_Jobs.cpp"
+#include "Unix_Time.cpp"
+#include "Unix_Config.cpp"
+#include "Unix_FrameWriter.cpp"
+#include "Unix_Capture.cpp"
+#include "Unix_Metrics.cpp"
 
 #include "X11/XKBlib.h"
 
@@ -32,21 +39,15 @@ struct GLRenderAsset
   GLuint ElementCount; // Number of elements in VAO's internal EBO. 
 };
 
-struct ParticleRenderCommand
-{
-  Matrix4x4 WorldTransform; // 4x4 World Transform Matrix
-  ColorRGB Color;
-  float Radius;
-};
-
 
 
 Unix_Display_State_Data UnixDisplayState;
 
 GLRenderAsset DebugParticle;
 
-ParticleRenderCommand RenderCommands[512];
+ParticleRenderCommand* RenderCommands = nullptr;
 int ParticleRenderCommandCount = 0;
+int ParticleRenderCommandCapacity = 0;
 
 Matrix4x4 ViewportMatrix;
 
@@ -59,6 +60,12 @@ void ExitApplication()
 
 void AddParticleRenderCommand(Matrix4x4 TransformMatrix, ColorRGB Color, float Radius)
 {
+  if (ParticleRenderCommandCount == ParticleRenderCommandCapacity)
+    {
+      ParticleRenderCommandCapacity = ParticleRenderCommandCapacity > 0 ? ParticleRenderCommandCapacity * 2 : 512;
+      RenderCommands = static_cast<ParticleRenderCommand*>(realloc(RenderCommands, ParticleRenderCommandCapacity * sizeof(ParticleRenderCommand)));
+    }
+  
   RenderCommands[ParticleRenderCommandCount].WorldTransform = TransformMatrix;
   RenderCommands[ParticleRenderCommandCount].Color = Color;
   RenderCommands[ParticleRenderCommandCount].Radius = Radius;
@@ -290,34 +297,122 @@ bool InitializeDisplayState(const char* MainWindowName, int WindowWidth, int Win
 
 
 
+// Usage: Particles [ConfigFile] [--capture <OutputPath>] [--capture-rate <FramesPerSecond>] [--metrics <SocketPath>] [--governor-log <LogPath>]
+// Governor decisions get logged to LogPath when given, to the standard output otherwise.
+// Capture OutputPath ending in ".y4m" writes a Y4M stream, anything else is a PPM pattern such as "capture/frame_%05d.ppm".
+// Captured frames get resampled to the capture rate, 60 by default.
 int main(int argc, char* argv[])
 {
+  SimulationContext Context;
+  const char* CapturePath = nullptr;
+  int CaptureRate = 60;
+  const char* MetricsSocketPath = nullptr;
+  const char* GovernorLogPath = nullptr;
+  
+  for (int ArgIndex = 1; ArgIndex < argc; ArgIndex++)
+    {
+      if (strcmp(argv[ArgIndex], "--capture") == 0 && ArgIndex + 1 < argc)
+	{
+	  CapturePath = argv[++ArgIndex];
+	  continue;
+	}
+      if (strcmp(argv[ArgIndex], "--capture-rate") == 0 && ArgIndex + 1 < argc)
+	{
+	  CaptureRate = atoi(argv[++ArgIndex]);
+	  if (CaptureRate <= 0)
+	    {
+	      printf("ERROR - Invalid capture rate '%s' !\n", argv[ArgIndex]);
+	      return 1;
+	    }
+	  continue;
+	}
+      if (strcmp(argv[ArgIndex], "--metrics") == 0 && ArgIndex + 1 < argc)
+	{
+	  MetricsSocketPath = argv[++ArgIndex];
+	  continue;
+	}
+      if (strcmp(argv[ArgIndex], "--governor-log") == 0 && ArgIndex + 1 < argc)
+	{
+	  GovernorLogPath = argv[++ArgIndex];
+	  continue;
+	}
+      
+      if (!ReadConfigFile(argv[ArgIndex], Context.Config))
+	{
+	  return 1;
+	}
+    }
+
+  Unix_InitializeJobPool(0);
+
+  FILE* GovernorLog = nullptr;
+  if (GovernorLogPath != nullptr)
+    {
+      GovernorLog = fopen(GovernorLogPath, "w");
+      if (GovernorLog == nullptr)
+	{
+	  printf("ERROR - Couldn't open governor log '%s' !\n", GovernorLogPath);
+	  return 1;
+	}
+    }
+
+  QualityGovernor Governor;
+  InitializeQualityGovernor(Governor, Context.Config, UnixJobPool.WorkerCount, Unix_SetEnabledWorkerCount, GovernorLog);
+  
   InitializeDisplayState("Particles Simulation", 1920, 1080);
 
   LoadRenderAsset("./Mesh_DebugParticle.mesh", "./VertexShader.shader", "./FragmentShader.shader", DebugParticle);
   
   glEnable(GL_DEPTH_TEST);
 
+  if (CapturePath != nullptr)
+    {
+      // The window manager may have given the window another size than requested.
+      XWindowAttributes WindowAttributes = {0};
+      XGetWindowAttributes(UnixDisplayState.DisplayServer, UnixDisplayState.MainWindow, &WindowAttributes);
+      int CaptureWidth = WindowAttributes.width < 1920 ? WindowAttributes.width : 1920;
+      int CaptureHeight = WindowAttributes.height < 1080 ? WindowAttributes.height : 1080;
+      if (!Unix_StartCapture(CapturePath, CaptureWidth, CaptureHeight, CaptureRate))
+	{
+	  return 1;
+	}
+    }
+
+  if (MetricsSocketPath != nullptr && !Unix_StartMetricsServer(MetricsSocketPath))
+    {
+      return 1;
+    }
+
   printf("Program ready. Launching main loop.\n");
 
-  SimulationContext Context;
   Context.SendParticleRenderCommand = AddParticleRenderCommand;
   Context.SetViewportMatrix = SetViewportMatrix;
   Context.SendExitApplicationCommand = ExitApplication;
+  Context.RunParallelJobs = Unix_RunParallelJobs;
+  Context.GetWallClockSeconds = GetWallClockSeconds;
+  Context.RecordInitialState = Unix_RecordInitialMetrics;
   
   UnixDisplayState.DisplayServerFD = ConnectionNumber(UnixDisplayState.DisplayServer);
   
   fd_set WindowEventPollingFDSet;
   timeval WindowEventPollingTimeval = {0, 0};
-  int FrameStartClock, FrameEndClock;
+  double FrameStartTime, FrameEndTime;
+  double StageSeconds[METRICS_STAGE_COUNT];
   float LastFrameTimeDeltaSeconds = 0.f;
   while(!UnixDisplayState.ShouldCloseDisplay)
     {
       // Event Handling
       FD_ZERO(&WindowEventPollingFDSet);
       FD_SET(UnixDisplayState.DisplayServerFD, &WindowEventPollingFDSet);
+      int MaxPolledFD = UnixDisplayState.DisplayServerFD;
+      Unix_AddMetricsFDs(WindowEventPollingFDSet, MaxPolledFD);
 
-      int ReadyFDs = select(UnixDisplayState.DisplayServerFD + 1, &WindowEventPollingFDSet, NULL, NULL, &WindowEventPollingTimeval); 
+      int ReadyFDs = select(MaxPolledFD + 1, &WindowEventPollingFDSet, NULL, NULL, &WindowEventPollingTimeval); 
+      if (ReadyFDs > 0)
+	{
+	  Unix_ServeMetrics(WindowEventPollingFDSet, Context);
+	}
+      
       if (ReadyFDs >= 0)
 	{
 	  XEvent NextEvent;
@@ -330,6 +425,7 @@ int main(int argc, char* argv[])
 		  XWindowAttributes WindowAttributes = {0};
 		  XGetWindowAttributes(UnixDisplayState.DisplayServer, UnixDisplayState.MainWindow, &WindowAttributes);
 		  glViewport(0, 0, WindowAttributes.width, WindowAttributes.height);
+		  Unix_SetCaptureViewport(WindowAttributes.width, WindowAttributes.height);
 		}
 	      else if (NextEvent.type == KeyPress)
 		{
@@ -366,13 +462,26 @@ int main(int argc, char* argv[])
 	}
 
       // Frame
-      FrameStartClock = clock();
+      FrameStartTime = GetWallClockSeconds();
       RunSimulation(Context, LastFrameTimeDeltaSeconds);
+      double SimulationEndTime = GetWallClockSeconds();
       OpenGL_DrawParticles();
+      double DrawEndTime = GetWallClockSeconds();
+      Unix_CaptureFrame();
+      double CaptureEndTime = GetWallClockSeconds();
       glXSwapBuffers(UnixDisplayState.DisplayServer, UnixDisplayState.MainWindow);
-      FrameEndClock = clock();
+      FrameEndTime = GetWallClockSeconds();
       
-      LastFrameTimeDeltaSeconds = (FrameEndClock - FrameStartClock) / static_cast<float>(CLOCKS_PER_SEC);
+      LastFrameTimeDeltaSeconds = static_cast<float>(FrameEndTime - FrameStartTime);
+
+      StageSeconds[METRICS_STAGE_SIMULATION] = SimulationEndTime - FrameStartTime;
+      StageSeconds[METRICS_STAGE_DRAW] = DrawEndTime - SimulationEndTime;
+      StageSeconds[METRICS_STAGE_CAPTURE] = CaptureEndTime - DrawEndTime;
+      StageSeconds[METRICS_STAGE_SWAP] = FrameEndTime - CaptureEndTime;
+      Unix_RecordFrameMetrics(Context, FrameEndTime - FrameStartTime, StageSeconds);
+
+      // Swapping waits for vertical sync and capture is optional: neither counts towards the governor's budget.
+      UpdateQualityGovernor(Governor, Context, StageSeconds[METRICS_STAGE_SIMULATION], StageSeconds[METRICS_STAGE_DRAW]);
 
       // "Advance" all inputs (Pressed -> Held, Released -> None).
       for(int InputKeyIndex = 0; InputKeyIndex < static_cast<int>(SimulationInputKey::KEY_COUNT); InputKeyIndex++)
@@ -391,6 +500,16 @@ int main(int argc, char* argv[])
 	}
     }
 
+  Unix_StopCapture();
+  Unix_StopMetricsServer();
+  if (GovernorLog != nullptr)
+    {
+      fclose(GovernorLog);
+    }
+  ShutdownSimulation(Context);
+  Unix_ShutdownJobPool();
+  free(RenderCommands);
+
   glXMakeCurrent(UnixDisplayState.DisplayServer, None, NULL);
   glXDestroyContext(UnixDisplayState.DisplayServer, UnixDisplayState.GLContext);
   XDestroyWindow(UnixDisplayState.DisplayServer, UnixDisplayState.MainWindow);
@@ -0,0 +1,551 @@
+// Live metrics served over a local Unix domain socket, in Prometheus text exposition format.
+// The listening socket and accepted clients are non blocking and get polled from the main loop's select(): a client
+// is answered as soon as it sent its request (or closed its writing side), then disconnected. Requests starting with
+// "GET" get an HTTP/1.0 response, anything else gets the plain metrics text, e.g.:
+//   curl --unix-socket /tmp/particles.sock http://localhost/metrics
+//   nc -U /tmp/particles.sock < /dev/null
+//
+// Clients get disconnected unanswered when their request didn't arrive within UNIX_METRICS_CLIENT_TIMEOUT seconds, so that
+// stuck scrapers can't hold every client slot.
+//
+// Energy and momentum cost a pass over all pairs of sources. They get computed by a thread of their own from a snapshot
+// of the Particles taken at most every UNIX_METRICS_STATISTICS_INTERVAL seconds, so that requests only format the
+// latest results and the main loop only pays for the copy. Drift is measured against a snapshot of the initial conditions,
+// taken from InitializeSimulation through SimulationContext::RecordInitialState.
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/select.h>
+#include <errno.h>
+
+#define UNIX_METRICS_MAX_CLIENTS 8
+#define UNIX_METRICS_RESPONSE_SIZE 8192
+#define UNIX_METRICS_CLIENT_TIMEOUT 2.0
+
+// Energy and momentum statistics are skipped above this many sources.
+#define UNIX_METRICS_STATISTICS_SOURCE_LIMIT 32768
+#define UNIX_METRICS_STATISTICS_INTERVAL 1.0
+
+// Weight of the latest frame in the exponentially smoothed frame timings.
+#define UNIX_METRICS_SMOOTHING 0.05
+
+enum Unix_Metrics_Stage
+  {
+    METRICS_STAGE_SIMULATION,
+    METRICS_STAGE_DRAW,
+    METRICS_STAGE_CAPTURE,
+    METRICS_STAGE_SWAP,
+
+    METRICS_STAGE_COUNT
+  };
+
+static const char* Unix_MetricsStageNames[] = { "simulation", "draw", "capture", "swap" };
+
+struct Unix_Metrics_State_Data
+{
+  bool IsActive = false;
+  char SocketPath[108] = {0};
+  int ListenFD = -1;
+  int ClientFDs[UNIX_METRICS_MAX_CLIENTS];
+  double ClientDeadlines[UNIX_METRICS_MAX_CLIENTS];
+  int ClientCount = 0;
+
+  double StartTime = 0;
+  long long FrameCount = 0;
+  double SmoothedFrameSeconds = 0;
+  double SmoothedStageSeconds[METRICS_STAGE_COUNT] = {0};
+  double LastStageSeconds[METRICS_STAGE_COUNT] = {0};
+  double SmoothedPairInteractionsPerSecond = 0;
+  double SmoothedTicksPerSecond = 0;
+
+  // Simulation counters at the end of the previous frame. A frame can run several ticks (substeps).
+  int LastTickCount = 0;
+  long long LastPairInteractionTotal = 0;
+
+  // Statistics thread. The snapshot holds active sources first, then tracers, and belongs to the thread while IsComputing.
+  pthread_t StatisticsThread;
+  pthread_mutex_t StatisticsMutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t SnapshotTaken = PTHREAD_COND_INITIALIZER;
+  pthread_cond_t StatisticsComputed = PTHREAD_COND_INITIALIZER;
+  bool IsComputing = false;
+  bool IsInitialSnapshot = false; // The snapshot holds initial conditions.
+  bool StopRequested = false;
+  Particle* Snapshot = nullptr;
+  int SnapshotCapacity = 0;
+  int SnapshotCount = 0;
+  int SnapshotTick = 0;
+  double LastSnapshotTime = 0;
+  double LastSnapshotSeconds = 0; // Time the main loop spent copying the last snapshot.
+
+  // Latest statistics and those of the initial conditions, guarded by StatisticsMutex.
+  bool HasStats = false;
+  bool HasInitialStats = false;
+  SimulationStatistics InitialStats;
+  SimulationStatistics LatestStats;
+  int StatsTick = 0;
+  double StatsSeconds = 0;
+};
+
+Unix_Metrics_State_Data UnixMetricsState;
+
+void* Unix_MetricsStatisticsMain(void*)
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+
+  pthread_mutex_lock(&ms.StatisticsMutex);
+  while(true)
+    {
+      while (!ms.IsComputing && !ms.StopRequested)
+	{
+	  pthread_cond_wait(&ms.SnapshotTaken, &ms.StatisticsMutex);
+	}
+
+      if (ms.StopRequested)
+	{
+	  break;
+	}
+
+      int SnapshotCount = ms.SnapshotCount;
+      int SnapshotTick = ms.SnapshotTick;
+      pthread_mutex_unlock(&ms.StatisticsMutex);
+
+      double StartTime = GetWallClockSeconds();
+      SimulationStatistics Stats = ComputeParticleStatistics(ms.Snapshot, SnapshotCount, true);
+      double Seconds = GetWallClockSeconds() - StartTime;
+
+      pthread_mutex_lock(&ms.StatisticsMutex);
+      if (ms.IsInitialSnapshot)
+	{
+	  ms.InitialStats = Stats;
+	  ms.HasInitialStats = true;
+	}
+      ms.HasStats = true;
+      ms.LatestStats = Stats;
+      ms.StatsTick = SnapshotTick;
+      ms.StatsSeconds = Seconds;
+      ms.IsComputing = false;
+      pthread_cond_signal(&ms.StatisticsComputed);
+    }
+  pthread_mutex_unlock(&ms.StatisticsMutex);
+
+  return nullptr;
+}
+
+// Copies active Particles, sources first, and hands them to the statistics thread if it is idle and the interval elapsed.
+// The snapshot of initial conditions is always taken, once the computation in progress, if any, is done.
+void Unix_TakeStatisticsSnapshot(const SimulationContext& Context, bool IsInitial)
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+
+  double StartTime = GetWallClockSeconds();
+  if ((!IsInitial && StartTime - ms.LastSnapshotTime < UNIX_METRICS_STATISTICS_INTERVAL) || Context.ParticleCount == 0)
+    {
+      return;
+    }
+
+  // Sources aren't counted until the first tick: count them from the Particles.
+  int SourceCount = 0;
+  for (int ParticleIndex = 0; ParticleIndex < Context.ParticleCount; ParticleIndex++)
+    {
+      SourceCount += Context.Particles[ParticleIndex].IsActive && !Context.Particles[ParticleIndex].IsTracer;
+    }
+  if (SourceCount > UNIX_METRICS_STATISTICS_SOURCE_LIMIT)
+    {
+      return;
+    }
+
+  pthread_mutex_lock(&ms.StatisticsMutex);
+  while (IsInitial && ms.IsComputing)
+    {
+      pthread_cond_wait(&ms.StatisticsComputed, &ms.StatisticsMutex);
+    }
+  bool IsComputing = ms.IsComputing;
+  pthread_mutex_unlock(&ms.StatisticsMutex);
+  if (IsComputing)
+    {
+      return;
+    }
+
+  if (Context.ParticleCount > ms.SnapshotCapacity)
+    {
+      free(ms.Snapshot);
+      ms.Snapshot = static_cast<Particle*>(malloc(Context.ParticleCount * sizeof(Particle)));
+      ms.SnapshotCapacity = ms.Snapshot != nullptr ? Context.ParticleCount : 0;
+      if (ms.Snapshot == nullptr)
+	{
+	  return;
+	}
+    }
+
+  int SnapshotCount = 0;
+  for (int Pass = 0; Pass < 2; Pass++)
+    {
+      bool AreTracersCopied = Pass == 1;
+      for (int ParticleIndex = 0; ParticleIndex < Context.ParticleCount; ParticleIndex++)
+	{
+	  const Particle& Part = Context.Particles[ParticleIndex];
+	  if (Part.IsActive && Part.IsTracer == AreTracersCopied)
+	    {
+	      ms.Snapshot[SnapshotCount++] = Part;
+	    }
+	}
+    }
+
+  ms.LastSnapshotTime = StartTime;
+  ms.LastSnapshotSeconds = GetWallClockSeconds() - StartTime;
+
+  pthread_mutex_lock(&ms.StatisticsMutex);
+  if (IsInitial)
+    {
+      // Results of a previous Simulation no longer apply.
+      ms.HasStats = false;
+      ms.HasInitialStats = false;
+    }
+  ms.IsInitialSnapshot = IsInitial;
+  ms.SnapshotCount = SnapshotCount;
+  ms.SnapshotTick = Context.TickCount;
+  ms.IsComputing = true;
+  pthread_cond_signal(&ms.SnapshotTaken);
+  pthread_mutex_unlock(&ms.StatisticsMutex);
+}
+
+bool Unix_StartMetricsServer(const char* SocketPath)
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+
+  sockaddr_un Address = {};
+  Address.sun_family = AF_UNIX;
+  if (strlen(SocketPath) >= sizeof(Address.sun_path))
+    {
+      printf("ERROR - Metrics socket path '%s' is too long !\n", SocketPath);
+      return false;
+    }
+  strcpy(Address.sun_path, SocketPath);
+
+  ms.ListenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ms.ListenFD < 0)
+    {
+      printf("ERROR - Couldn't create metrics socket: %s\n", strerror(errno));
+      return false;
+    }
+
+  // A socket file left by a previous run would make bind() fail.
+  unlink(SocketPath);
+  if (bind(ms.ListenFD, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) < 0 || listen(ms.ListenFD, UNIX_METRICS_MAX_CLIENTS) < 0)
+    {
+      printf("ERROR - Couldn't listen on metrics socket '%s': %s\n", SocketPath, strerror(errno));
+      close(ms.ListenFD);
+      ms.ListenFD = -1;
+      return false;
+    }
+  fcntl(ms.ListenFD, F_SETFL, fcntl(ms.ListenFD, F_GETFL) | O_NONBLOCK);
+
+  if (pthread_create(&ms.StatisticsThread, NULL, Unix_MetricsStatisticsMain, NULL) != 0)
+    {
+      printf("ERROR - Couldn't create metrics statistics thread !\n");
+      close(ms.ListenFD);
+      ms.ListenFD = -1;
+      return false;
+    }
+
+  strcpy(ms.SocketPath, SocketPath);
+  ms.StartTime = GetWallClockSeconds();
+  ms.IsActive = true;
+  printf("Serving metrics on '%s'.\n", SocketPath);
+  return true;
+}
+
+void Unix_StopMetricsServer()
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+  if (!ms.IsActive)
+    {
+      return;
+    }
+
+  for (int ClientIndex = 0; ClientIndex < ms.ClientCount; ClientIndex++)
+    {
+      close(ms.ClientFDs[ClientIndex]);
+    }
+  close(ms.ListenFD);
+  unlink(ms.SocketPath);
+
+  pthread_mutex_lock(&ms.StatisticsMutex);
+  ms.StopRequested = true;
+  pthread_cond_signal(&ms.SnapshotTaken);
+  pthread_mutex_unlock(&ms.StatisticsMutex);
+  pthread_join(ms.StatisticsThread, NULL);
+  free(ms.Snapshot);
+
+  ms.Snapshot = nullptr;
+  ms.SnapshotCapacity = 0;
+  ms.ClientCount = 0;
+  ms.ListenFD = -1;
+  ms.IsActive = false;
+}
+
+// Records timings of the frame that just ended. StageSeconds holds METRICS_STAGE_COUNT values.
+void Unix_RecordFrameMetrics(const SimulationContext& Context, double FrameSeconds, const double* StageSeconds)
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+  if (!ms.IsActive)
+    {
+      return;
+    }
+
+  double Weight = ms.FrameCount == 0 ? 1.0 : UNIX_METRICS_SMOOTHING;
+  ms.SmoothedFrameSeconds += (FrameSeconds - ms.SmoothedFrameSeconds) * Weight;
+  for (int StageIndex = 0; StageIndex < METRICS_STAGE_COUNT; StageIndex++)
+    {
+      ms.LastStageSeconds[StageIndex] = StageSeconds[StageIndex];
+      ms.SmoothedStageSeconds[StageIndex] += (StageSeconds[StageIndex] - ms.SmoothedStageSeconds[StageIndex]) * Weight;
+    }
+
+  int FrameTickCount = Context.TickCount - ms.LastTickCount;
+  long long FramePairInteractions = Context.PairInteractionTotal - ms.LastPairInteractionTotal;
+  ms.LastTickCount = Context.TickCount;
+  ms.LastPairInteractionTotal = Context.PairInteractionTotal;
+
+  // Rates need the previous frame's counters.
+  if (ms.FrameCount > 0)
+    {
+      double RateWeight = ms.FrameCount == 1 ? 1.0 : UNIX_METRICS_SMOOTHING;
+      if (FrameSeconds > 0)
+	{
+	  ms.SmoothedTicksPerSecond += (FrameTickCount / FrameSeconds - ms.SmoothedTicksPerSecond) * RateWeight;
+	}
+      if (StageSeconds[METRICS_STAGE_SIMULATION] > 0)
+	{
+	  double PairInteractionsPerSecond = FramePairInteractions / StageSeconds[METRICS_STAGE_SIMULATION];
+	  ms.SmoothedPairInteractionsPerSecond += (PairInteractionsPerSecond - ms.SmoothedPairInteractionsPerSecond) * RateWeight;
+	}
+    }
+
+  ms.FrameCount++;
+
+  Unix_TakeStatisticsSnapshot(Context, false);
+}
+
+// Meant for SimulationContext::RecordInitialState: snapshots the initial conditions, reference of energy and momentum drift.
+void Unix_RecordInitialMetrics(const SimulationContext& Context)
+{
+  if (UnixMetricsState.IsActive)
+    {
+      Unix_TakeStatisticsSnapshot(Context, true);
+    }
+}
+
+// Resident memory of the process in bytes, 0 if unknown.
+long long Unix_GetResidentMemoryBytes()
+{
+  FILE* StatmFile = fopen("/proc/self/statm", "r");
+  if (StatmFile == nullptr)
+    {
+      return 0;
+    }
+
+  long long TotalPages = 0, ResidentPages = 0;
+  int ReadFields = fscanf(StatmFile, "%lld %lld", &TotalPages, &ResidentPages);
+  fclose(StatmFile);
+
+  return ReadFields == 2 ? ResidentPages * sysconf(_SC_PAGESIZE) : 0;
+}
+
+// Appends a metric with its HELP and TYPE lines to the response.
+static void Unix_AppendMetric(char* Response, int& Length, const char* Name, const char* Type, const char* Help, double Value)
+{
+  if (Length < UNIX_METRICS_RESPONSE_SIZE)
+    {
+      Length += snprintf(Response + Length, UNIX_METRICS_RESPONSE_SIZE - Length, "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n",
+			 Name, Help, Name, Type, Name, Value);
+    }
+}
+
+int Unix_FormatMetrics(const SimulationContext& Context, char* Response)
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+  int Length = 0;
+
+  Unix_AppendMetric(Response, Length, "particles_uptime_seconds", "gauge", "Time since the metrics server started.",
+		    GetWallClockSeconds() - ms.StartTime);
+  Unix_AppendMetric(Response, Length, "particles_ticks_total", "counter", "Simulation ticks run.", Context.TickCount);
+  Unix_AppendMetric(Response, Length, "particles_tick_rate_hertz", "gauge", "Smoothed simulation ticks per second, substeps included.",
+		    ms.SmoothedTicksPerSecond);
+  Unix_AppendMetric(Response, Length, "particles_frame_rate_hertz", "gauge", "Frames per second from the smoothed frame duration.",
+		    ms.SmoothedFrameSeconds > 0 ? 1.0 / ms.SmoothedFrameSeconds : 0);
+  Unix_AppendMetric(Response, Length, "particles_substeps", "gauge", "Simulation ticks run per frame.", Context.SubstepCount);
+  Unix_AppendMetric(Response, Length, "particles_frame_seconds", "gauge", "Smoothed duration of a whole frame.", ms.SmoothedFrameSeconds);
+
+  if (Length < UNIX_METRICS_RESPONSE_SIZE)
+    {
+      Length += snprintf(Response + Length, UNIX_METRICS_RESPONSE_SIZE - Length,
+			 "# HELP particles_stage_seconds Smoothed duration of each frame stage.\n# TYPE particles_stage_seconds gauge\n");
+    }
+  for (int StageIndex = 0; StageIndex < METRICS_STAGE_COUNT && Length < UNIX_METRICS_RESPONSE_SIZE; StageIndex++)
+    {
+      Length += snprintf(Response + Length, UNIX_METRICS_RESPONSE_SIZE - Length, "particles_stage_seconds{stage=\"%s\"} %.9g\n",
+			 Unix_MetricsStageNames[StageIndex], ms.SmoothedStageSeconds[StageIndex]);
+    }
+
+  Unix_AppendMetric(Response, Length, "particles_count", "gauge", "Allocated particles.", Context.ParticleCount);
+  Unix_AppendMetric(Response, Length, "particles_active_count", "gauge", "Active particles during the last tick.", Context.ActiveParticleCount);
+  Unix_AppendMetric(Response, Length, "particles_pair_interactions_total", "counter", "Particle pair interactions evaluated.",
+		    static_cast<double>(Context.PairInteractionTotal));
+  Unix_AppendMetric(Response, Length, "particles_pair_interactions_per_second", "gauge",
+		    "Smoothed particle pair interactions evaluated per second of simulation stage.", ms.SmoothedPairInteractionsPerSecond);
+  Unix_AppendMetric(Response, Length, "particles_reorders_total", "counter", "Morton reorders of particles.", Context.ReorderCount);
+  Unix_AppendMetric(Response, Length, "particles_last_reorder_seconds", "gauge", "Duration of the last Morton reorder.", Context.LastReorderSeconds);
+  Unix_AppendMetric(Response, Length, "particles_reorder_seconds_total", "counter", "Time spent in Morton reorders.", Context.ReorderSecondsTotal);
+  if (Context.Config.ReproducibleForces)
+    {
+      Unix_AppendMetric(Response, Length, "particles_fixed_point_shift", "gauge",
+			"Fractional bits of reproducible force sums during the last tick, lowered below 40 by heavy sources.", Context.FixedPointShift);
+    }
+  Unix_AppendMetric(Response, Length, "particles_resident_memory_bytes", "gauge", "Resident memory of the process.",
+		    static_cast<double>(Unix_GetResidentMemoryBytes()));
+
+  Unix_AppendMetric(Response, Length, "particles_statistics_snapshot_seconds", "gauge",
+		    "Time the main loop spent copying particles for the last energy and momentum computation.", ms.LastSnapshotSeconds);
+
+  pthread_mutex_lock(&ms.StatisticsMutex);
+  bool HasStats = ms.HasStats;
+  bool HasInitialStats = ms.HasInitialStats;
+  SimulationStatistics InitialStats = ms.InitialStats;
+  SimulationStatistics Stats = ms.LatestStats;
+  int StatsTick = ms.StatsTick;
+  double StatsSeconds = ms.StatsSeconds;
+  pthread_mutex_unlock(&ms.StatisticsMutex);
+
+  // Latest results of the statistics thread, absent until its first computation or above the source limit.
+  if (HasStats && Context.SourceParticleCount <= UNIX_METRICS_STATISTICS_SOURCE_LIMIT)
+    {
+      Unix_AppendMetric(Response, Length, "particles_statistics_tick", "gauge", "Tick energy and momentum were last computed at.", StatsTick);
+      Unix_AppendMetric(Response, Length, "particles_statistics_seconds", "gauge", "Duration of the last energy and momentum computation.",
+			StatsSeconds);
+
+      double Momentum = sqrt(LengthSquared(Stats.Momentum));
+      Unix_AppendMetric(Response, Length, "particles_total_energy", "gauge", "Kinetic plus potential energy.", Stats.TotalEnergy);
+      Unix_AppendMetric(Response, Length, "particles_momentum", "gauge", "Magnitude of total momentum.", Momentum);
+
+      if (HasInitialStats)
+	{
+	  double InitialEnergy = InitialStats.TotalEnergy;
+	  double InitialMomentum = sqrt(LengthSquared(InitialStats.Momentum));
+	  Unix_AppendMetric(Response, Length, "particles_energy_drift_ratio", "gauge", "Relative total energy change since the simulation started.",
+			    InitialEnergy != 0 ? (Stats.TotalEnergy - InitialEnergy) / fabs(InitialEnergy) : 0);
+	  Unix_AppendMetric(Response, Length, "particles_momentum_drift", "gauge", "Total momentum magnitude change since the simulation started.",
+			    Momentum - InitialMomentum);
+	}
+    }
+
+  return Length < UNIX_METRICS_RESPONSE_SIZE ? Length : UNIX_METRICS_RESPONSE_SIZE - 1;
+}
+
+// Adds the listening socket and pending clients to a select() read set. Clients past their deadline get disconnected first.
+void Unix_AddMetricsFDs(fd_set& ReadFDSet, int& MaxFD)
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+  if (!ms.IsActive)
+    {
+      return;
+    }
+
+  double Now = GetWallClockSeconds();
+  for (int ClientIndex = 0; ClientIndex < ms.ClientCount; ClientIndex++)
+    {
+      if (Now > ms.ClientDeadlines[ClientIndex])
+	{
+	  close(ms.ClientFDs[ClientIndex]);
+	  ms.ClientFDs[ClientIndex] = ms.ClientFDs[--ms.ClientCount];
+	  ms.ClientDeadlines[ClientIndex--] = ms.ClientDeadlines[ms.ClientCount];
+	}
+    }
+
+  FD_SET(ms.ListenFD, &ReadFDSet);
+  MaxFD = ms.ListenFD > MaxFD ? ms.ListenFD : MaxFD;
+
+  for (int ClientIndex = 0; ClientIndex < ms.ClientCount; ClientIndex++)
+    {
+      FD_SET(ms.ClientFDs[ClientIndex], &ReadFDSet);
+      MaxFD = ms.ClientFDs[ClientIndex] > MaxFD ? ms.ClientFDs[ClientIndex] : MaxFD;
+    }
+}
+
+// Accepts new clients and answers the ones whose request arrived, from the result of select().
+void Unix_ServeMetrics(const fd_set& ReadyFDSet, const SimulationContext& Context)
+{
+  Unix_Metrics_State_Data& ms = UnixMetricsState;
+  if (!ms.IsActive)
+    {
+      return;
+    }
+
+  for (int ClientIndex = 0; ClientIndex < ms.ClientCount; ClientIndex++)
+    {
+      int ClientFD = ms.ClientFDs[ClientIndex];
+      if (!FD_ISSET(ClientFD, &ReadyFDSet))
+	{
+	  continue;
+	}
+
+      char Request[512];
+      ssize_t RequestLength = recv(ClientFD, Request, sizeof(Request), 0);
+      if (RequestLength < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+	  continue;
+	}
+
+      char Body[UNIX_METRICS_RESPONSE_SIZE];
+      int BodyLength = Unix_FormatMetrics(Context, Body);
+
+      if (RequestLength >= 3 && strncmp(Request, "GET", 3) == 0)
+	{
+	  char Header[256];
+	  int HeaderLength = snprintf(Header, sizeof(Header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+				      "Content-Length: %d\r\nConnection: close\r\n\r\n", BodyLength);
+	  send(ClientFD, Header, HeaderLength, MSG_NOSIGNAL);
+	}
+      send(ClientFD, Body, BodyLength, MSG_NOSIGNAL);
+
+      close(ClientFD);
+      ms.ClientFDs[ClientIndex] = ms.ClientFDs[--ms.ClientCount];
+      ms.ClientDeadlines[ClientIndex--] = ms.ClientDeadlines[ms.ClientCount];
+    }
+
+  if (FD_ISSET(ms.ListenFD, &ReadyFDSet))
+    {
+      while (ms.ClientCount < UNIX_METRICS_MAX_CLIENTS)
+	{
+	  int ClientFD = accept(ms.ListenFD, NULL, NULL);
+	  if (ClientFD < 0)
+	    {
+	      break;
+	    }
+
+	  fcntl(ClientFD, F_SETFL, fcntl(ClientFD, F_GETFL) | O_NONBLOCK);
+	  ms.ClientDeadlines[ms.ClientCount] = GetWallClockSeconds() + UNIX_METRICS_CLIENT_TIMEOUT;
+	  ms.ClientFDs[ms.ClientCount++] = ClientFD;
+	}
+    }
+}
+
+// For main loops without their own select(): checks the metrics sockets without waiting.
+void Unix_PollMetricsServer(const SimulationContext& Context)
+{
+  if (!UnixMetricsState.IsActive)
+    {
+      return;
+    }
+
+  fd_set ReadFDSet;
+  FD_ZERO(&ReadFDSet);
+  int MaxFD = -1;
+  Unix_AddMetricsFDs(ReadFDSet, MaxFD);
+
+  timeval NoWait = {0, 0};
+  if (select(MaxFD + 1, &ReadFDSet, NULL, NULL, &NoWait) > 0)
+    {
+      Unix_ServeMetrics(ReadFDSet, Context);
+    }
+}
@@ -0,0 +1,235 @@
+// Offline renderer: runs the Simulation without any display server and renders its frames on the CPU
+// (Render/SoftwareRenderer.cpp) to a PPM image sequence or a Y4M stream.
+//
+// Usage: ParticlesOffline <ConfigFile|-> <FrameCount> <OutputPath> [Options]
+// Options: -w <Width> -h <Height> -m <depth|additive|density> -i <Intensity> -t <TimeDelta> -r <FrameRate> -j <WorkerCount>
+//          -s <MetricsSocketPath>
+// A FrameBudget in the configuration enables the quality governor, logging to the standard output.
+// OutputPath ending in ".y4m" writes a Y4M stream, anything else is a PPM pattern such as "frames/frame_%05d.ppm".
+// Build: g++ -O2 Unix/Unix_Offline.cpp -o ParticlesOffline -lpthread
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <time.h>
+
+#include "../ParticleSimulation.cpp"
+#include "../Render/RenderCommands.h"
+#include "../Render/SoftwareRenderer.cpp"
+#include "Unix_Jobs.cpp"
+#include "Unix_Time.cpp"
+#include "Unix_Config.cpp"
+#include "Unix_FrameWriter.cpp"
+#include "Unix_Metrics.cpp"
+
+ParticleRenderCommand* RenderCommands = nullptr;
+int ParticleRenderCommandCount = 0;
+int ParticleRenderCommandCapacity = 0;
+
+Matrix4x4 ViewportMatrix = Matrix4x4::Identity;
+
+bool ShouldExit = false;
+
+// SIMULATION COMMANDS
+
+void ExitApplication()
+{
+  ShouldExit = true;
+}
+
+void AddParticleRenderCommand(Matrix4x4 TransformMatrix, ColorRGB Color, float Radius)
+{
+  if (ParticleRenderCommandCount == ParticleRenderCommandCapacity)
+    {
+      ParticleRenderCommandCapacity = ParticleRenderCommandCapacity > 0 ? ParticleRenderCommandCapacity * 2 : 512;
+      RenderCommands = static_cast<ParticleRenderCommand*>(realloc(RenderCommands, ParticleRenderCommandCapacity * sizeof(ParticleRenderCommand)));
+    }
+
+  RenderCommands[ParticleRenderCommandCount].WorldTransform = TransformMatrix;
+  RenderCommands[ParticleRenderCommandCount].Color = Color;
+  RenderCommands[ParticleRenderCommandCount].Radius = Radius;
+
+  ParticleRenderCommandCount++;
+}
+
+void SetViewportMatrix(Matrix4x4 NewViewMatrix)
+{
+  ViewportMatrix = NewViewMatrix;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+    {
+      printf("Usage: %s <ConfigFile|-> <FrameCount> <OutputPath> [-w Width] [-h Height] [-m depth|additive|density] "
+	     "[-i Intensity] [-t TimeDelta] [-r FrameRate] [-j WorkerCount] [-s MetricsSocketPath]\n", argv[0]);
+      return 1;
+    }
+
+  SimulationContext Context;
+  if (strcmp(argv[1], "-") != 0 && !ReadConfigFile(argv[1], Context.Config))
+    {
+      return 1;
+    }
+
+  int FrameCount = atoi(argv[2]);
+  const char* OutputPath = argv[3];
+
+  int Width = 1920;
+  int Height = 1080;
+  SoftwareRenderMode Mode = SoftwareRenderMode::DEPTH_TESTED;
+  float Intensity = 0.25f;
+  float TimeDelta = 1.f / 60.f;
+  int FrameRate = 60;
+  int WorkerCount = 0;
+  const char* MetricsSocketPath = nullptr;
+
+  for (int ArgIndex = 4; ArgIndex + 1 < argc; ArgIndex += 2)
+    {
+      const char* Option = argv[ArgIndex];
+      const char* Value = argv[ArgIndex + 1];
+
+      if (strcmp(Option, "-w") == 0)
+	{
+	  Width = atoi(Value);
+	}
+      else if (strcmp(Option, "-h") == 0)
+	{
+	  Height = atoi(Value);
+	}
+      else if (strcmp(Option, "-m") == 0)
+	{
+	  Mode = strcmp(Value, "additive") == 0 ? SoftwareRenderMode::ADDITIVE
+	    : strcmp(Value, "density") == 0 ? SoftwareRenderMode::DENSITY : SoftwareRenderMode::DEPTH_TESTED;
+	}
+      else if (strcmp(Option, "-i") == 0)
+	{
+	  Intensity = atof(Value);
+	}
+      else if (strcmp(Option, "-t") == 0)
+	{
+	  TimeDelta = atof(Value);
+	}
+      else if (strcmp(Option, "-r") == 0)
+	{
+	  FrameRate = atoi(Value);
+	}
+      else if (strcmp(Option, "-j") == 0)
+	{
+	  WorkerCount = atoi(Value);
+	}
+      else if (strcmp(Option, "-s") == 0)
+	{
+	  MetricsSocketPath = Value;
+	}
+      else
+	{
+	  printf("WARNING - Ignoring unknown option '%s'.\n", Option);
+	}
+    }
+
+  if (Width <= 0 || Height <= 0 || FrameCount <= 0)
+    {
+      printf("ERROR - Invalid frame size or count.\n");
+      return 1;
+    }
+
+  if (!Unix_InitializeJobPool(WorkerCount))
+    {
+      return 1;
+    }
+
+  SoftwareRenderer Renderer;
+  if (!InitializeSoftwareRenderer(Renderer, Width, Height, Mode))
+    {
+      printf("ERROR - Couldn't allocate %dx%d frame !\n", Width, Height);
+      return 1;
+    }
+  QualityGovernor Governor;
+  InitializeQualityGovernor(Governor, Context.Config, UnixJobPool.WorkerCount, Unix_SetEnabledWorkerCount, stdout);
+
+  Renderer.Intensity = Intensity;
+  Renderer.RunParallelJobs = Unix_RunParallelJobs;
+
+  if (MetricsSocketPath != nullptr && !Unix_StartMetricsServer(MetricsSocketPath))
+    {
+      return 1;
+    }
+
+  Unix_Frame_Writer Writer;
+  if (!Unix_OpenFrameWriter(Writer, OutputPath, Unix_GuessFrameFormat(OutputPath), Width, Height, FrameRate))
+    {
+      return 1;
+    }
+
+  // Nothing is ever pressed.
+  for (int InputKeyIndex = 0; InputKeyIndex < static_cast<int>(SimulationInputKey::KEY_COUNT); InputKeyIndex++)
+    {
+      Context.InputStates[InputKeyIndex] = SimulationInputState::NONE;
+    }
+
+  Context.SendParticleRenderCommand = AddParticleRenderCommand;
+  Context.SetViewportMatrix = SetViewportMatrix;
+  Context.SendExitApplicationCommand = ExitApplication;
+  Context.RunParallelJobs = Unix_RunParallelJobs;
+  Context.GetWallClockSeconds = GetWallClockSeconds;
+  Context.RecordInitialState = Unix_RecordInitialMetrics;
+
+  // First call only creates the initial Particles. The tick count stays 0 if that failed.
+  RunSimulation(Context, TimeDelta);
+  if (Context.TickCount == 0)
+    {
+      return 1;
+    }
+
+  printf("Rendering %d frames of %d particles at %dx%d on %d workers.\n", FrameCount, Context.ParticleCount, Width, Height, UnixJobPool.WorkerCount);
+
+  double SimulationSeconds = 0, RenderSeconds = 0, WriteSeconds = 0;
+  bool Succeeded = true;
+  for (int FrameIndex = 0; FrameIndex < FrameCount && !ShouldExit && Succeeded; FrameIndex++)
+    {
+      double FrameStartTime = GetWallClockSeconds();
+      RunSimulation(Context, TimeDelta);
+      double SimulationEndTime = GetWallClockSeconds();
+
+      SoftwareRenderParticles(Renderer, RenderCommands, ParticleRenderCommandCount, ViewportMatrix);
+      ParticleRenderCommandCount = 0;
+      double RenderEndTime = GetWallClockSeconds();
+
+      Succeeded = Unix_WriteFrame(Writer, Renderer.Pixels, 3, false);
+      double WriteEndTime = GetWallClockSeconds();
+
+      SimulationSeconds += SimulationEndTime - FrameStartTime;
+      RenderSeconds += RenderEndTime - SimulationEndTime;
+      WriteSeconds += WriteEndTime - RenderEndTime;
+
+      double StageSeconds[METRICS_STAGE_COUNT] = {0};
+      StageSeconds[METRICS_STAGE_SIMULATION] = SimulationEndTime - FrameStartTime;
+      StageSeconds[METRICS_STAGE_DRAW] = RenderEndTime - SimulationEndTime;
+      StageSeconds[METRICS_STAGE_CAPTURE] = WriteEndTime - RenderEndTime;
+      Unix_RecordFrameMetrics(Context, WriteEndTime - FrameStartTime, StageSeconds);
+      Unix_PollMetricsServer(Context);
+
+      UpdateQualityGovernor(Governor, Context, StageSeconds[METRICS_STAGE_SIMULATION], StageSeconds[METRICS_STAGE_DRAW]);
+    }
+
+  int WrittenFrames = Writer.FrameIndex;
+  if (WrittenFrames > 0)
+    {
+      printf("Wrote %d frames. Average per frame: simulation %.2fms, render %.2fms, write %.2fms.\n", WrittenFrames,
+	     SimulationSeconds * 1000 / WrittenFrames, RenderSeconds * 1000 / WrittenFrames, WriteSeconds * 1000 / WrittenFrames);
+    }
+
+  Unix_StopMetricsServer();
+  Unix_CloseFrameWriter(Writer);
+  ShutdownSoftwareRenderer(Renderer);
+  ShutdownSimulation(Context);
+  Unix_ShutdownJobPool();
+  free(RenderCommands);
+
+  return Succeeded ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#include <time.h>
+
+// Monotonic wall clock time, in seconds. Unlike clock(), it doesn't add up CPU time spent by other threads.
+double GetWallClockSeconds()
+{
+  timespec Now;
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return Now.tv_sec + Now.tv_nsec / 1e9;
+}